@@ -0,0 +1,366 @@
+#include "os_event.h"
+#include "os_input.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <util/atomic.h>
+
+/*! \file
+ *  Button debouncing with integrators and a lock-free event queue.
+ *
+ *  The producers are the tick and the pin change ISR. AVR interrupts do not
+ *  nest, so they never run at the same time and can share the button state
+ *  and the write position of the queue without locking.
+ */
+
+//! Number of buttons that can be handled (bits 0...3 of os_getInput)
+#define OS_EVENT_BUTTON_COUNT 4
+
+//! Converts milliseconds to ticks (at least one tick)
+#define OS_EVENT_TICKS(ms) ((ms) > OS_EVENT_TICK_MS ? ((ms) + OS_EVENT_TICK_MS - 1) / OS_EVENT_TICK_MS : 1)
+
+//! Value of an integrator at which a button counts as pressed
+#define OS_EVENT_INTEGRATOR_MAX OS_EVENT_TICKS(OS_EVENT_DEBOUNCE_MS)
+
+#if OS_EVENT_BUTTONS & ~((1 << OS_EVENT_BUTTON_COUNT) - 1)
+    #error "Only the lower 4 bits of os_getInput can be used for events"
+#endif
+
+#if OS_EVENT_QUEUE_SIZE & (OS_EVENT_QUEUE_SIZE - 1)
+    #error "OS_EVENT_QUEUE_SIZE has to be a power of 2"
+#endif
+
+#if OS_EVENT_OWN_TIMER
+    //! Prescaler of Timer2
+    #define OS_EVENT_TIMER_PRESCALER 128
+
+    //! Timer2 counts per tick
+    #define OS_EVENT_TIMER_COUNTS (F_CPU / 1000UL * OS_EVENT_TICK_MS / OS_EVENT_TIMER_PRESCALER)
+
+    #if OS_EVENT_TIMER_COUNTS > 256 || OS_EVENT_TIMER_COUNTS < 1
+        #error "OS_EVENT_TICK_MS cannot be reached with Timer2"
+    #endif
+
+    //! Microseconds per tick (rounded)
+    #define OS_EVENT_TICK_US ((OS_EVENT_TIMER_COUNTS * OS_EVENT_TIMER_PRESCALER * 1000UL + F_CPU / 2000UL) / (F_CPU / 1000UL))
+
+    //! Microseconds per count of Timer2 in 8.8 fixed point
+    #define OS_EVENT_COUNT_US_Q8 ((OS_EVENT_TIMER_PRESCALER * 256000000UL + F_CPU / 2) / F_CPU)
+#endif
+
+#if OS_EVENT_PCINT_MASK & ~((1 << PCINT16) | (1 << PCINT17) | (1 << PCINT18) | (1 << PCINT19) | (1 << PCINT20) | (1 << PCINT21) | (1 << PCINT22) | (1 << PCINT23))
+    #error "OS_EVENT_PCINT_MASK contains bits that are not in PCMSK2"
+#endif
+
+//! State of a single button
+typedef struct {
+    uint8_t integrator; //!< 0 (released) ... OS_EVENT_INTEGRATOR_MAX (pressed)
+    uint16_t held;      //!< Ticks since the debounced press
+    uint16_t repeat;    //!< Ticks until the next repeat event
+} ButtonState;
+
+//! Per-button state, only used by the tick
+static ButtonState osButtons[OS_EVENT_BUTTON_COUNT];
+
+//! Debounced button states
+static volatile uint8_t osDebounced;
+
+//! Buttons that repeat while they are held
+static uint8_t osRepeatButtons;
+
+//! Ticks until the first repeat event and between repeat events
+static uint16_t osRepeatDelay, osRepeatPeriod;
+
+//! Event queue (ring buffer)
+static volatile uint8_t osQueue[OS_EVENT_QUEUE_SIZE];
+
+//! Timestamps of the queued events in microseconds
+static volatile uint32_t osQueueTime[OS_EVENT_QUEUE_SIZE];
+
+//! Read position, only written by os_getEvent
+static volatile uint8_t osQueueHead;
+
+//! Write position, only written by the ISRs
+static volatile uint8_t osQueueTail;
+
+//! Called after an ISR has queued events
+static OsEventHook osHook;
+
+#if OS_EVENT_OWN_TIMER
+//! Ticks of Timer2 since os_initEvents
+static volatile uint32_t osTicks;
+#endif
+
+/*!
+ *  Timestamp of the events. With its own timer, the module counts the ticks
+ *  of Timer2 and adds the current count; the tick is rounded to whole
+ *  microseconds, which is precise enough to measure latencies. Otherwise
+ *  OS_EVENT_TIMESTAMP of the project is used.
+ *
+ *  \return The current time in microseconds.
+ */
+uint32_t os_eventMicros(void) {
+#if OS_EVENT_OWN_TIMER
+    uint32_t ticks;
+    uint8_t count;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        ticks = osTicks;
+        count = TCNT2;
+
+        // A tick that has not been handled yet: the counter already restarted
+        if (TIFR2 & (1 << OCF2A)) {
+            ticks++;
+            count = TCNT2;
+        }
+    }
+    return ticks * OS_EVENT_TICK_US + (((uint16_t)count * OS_EVENT_COUNT_US_Q8) >> 8);
+#else
+    return OS_EVENT_TIMESTAMP();
+#endif
+}
+
+/*!
+ *  Appends an event to the queue. Drops the event if the queue is full.
+ *  Only called from the ISRs.
+ *
+ *  \param event  The event.
+ *  \param time   Timestamp of the event in microseconds.
+ */
+static void os_pushEvent(uint8_t event, uint32_t time) {
+    uint8_t const tail = osQueueTail;
+    uint8_t const next = (tail + 1) & (OS_EVENT_QUEUE_SIZE - 1);
+
+    if (next != osQueueHead) {
+        osQueue[tail] = event;
+        osQueueTime[tail] = time;
+        // The event is complete before the consumer can see it
+        osQueueTail = next;
+    }
+}
+
+/*!
+ *  Resets the debouncing state and the queue. If the module has its own
+ *  timer, Timer2 is started in CTC mode with a tick of OS_EVENT_TICK_MS.
+ *  Calling it again does not disturb a running timer. The pin change
+ *  interrupt of port C is enabled for the pins in OS_EVENT_PCINT_MASK.
+ */
+void os_initEvents(void) {
+    uint8_t i;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        for (i = 0; i < OS_EVENT_BUTTON_COUNT; i++) {
+            osButtons[i].integrator = 0;
+        }
+        osDebounced = 0;
+        osQueueHead = osQueueTail = 0;
+
+        osRepeatButtons = OS_EVENT_REPEAT_BUTTONS;
+        osRepeatDelay = OS_EVENT_TICKS(OS_EVENT_REPEAT_DELAY_MS);
+        osRepeatPeriod = OS_EVENT_TICKS(OS_EVENT_REPEAT_PERIOD_MS);
+
+#if OS_EVENT_OWN_TIMER
+        if (!(TIMSK2 & (1 << OCIE2A))) {
+            // CTC mode, TOP = OCR2A, prescaler 128
+            TCCR2A = (1 << WGM21);
+            TCCR2B = (1 << CS22) | (1 << CS20);
+            OCR2A = OS_EVENT_TIMER_COUNTS - 1;
+            TCNT2 = 0;
+            TIMSK2 |= (1 << OCIE2A);
+            osTicks = 0;
+        }
+#endif
+
+#if OS_EVENT_PCINT_MASK
+        PCMSK2 |= OS_EVENT_PCINT_MASK;
+        PCIFR = (1 << PCIF2); // Drop an edge from before
+        PCICR |= (1 << PCIE2);
+#endif
+    }
+    sei();
+}
+
+/*!
+ *  Samples the buttons and updates the integrators. Emits a press or release
+ *  event when a debounced state changes, and long-press and repeat events
+ *  while a button is held.
+ *  Must be called from one timer ISR only (it is the only producer of the
+ *  queue).
+ */
+void os_eventTick(void) {
+    uint8_t const raw = os_getInput() & OS_EVENT_BUTTONS;
+    uint8_t debounced = osDebounced;
+    uint8_t const tail = osQueueTail;
+    uint8_t i;
+    uint8_t mask;
+
+    for (i = 0, mask = 1; i < OS_EVENT_BUTTON_COUNT; i++, mask <<= 1) {
+        ButtonState *const button = &osButtons[i];
+
+        if (!(OS_EVENT_BUTTONS & mask)) {
+            continue;
+        }
+
+        if (raw & mask) {
+            if (button->integrator < OS_EVENT_INTEGRATOR_MAX) {
+                if (++button->integrator == OS_EVENT_INTEGRATOR_MAX && !(debounced & mask)) {
+                    debounced |= mask;
+                    button->held = 0;
+                    button->repeat = osRepeatDelay;
+                    os_pushEvent(OS_EVENT_PRESS | mask, os_eventMicros());
+                }
+                continue;
+            }
+        } else if (button->integrator) {
+            if (!--button->integrator && (debounced & mask)) {
+                debounced &= ~mask;
+                os_pushEvent(OS_EVENT_RELEASE | mask, os_eventMicros());
+            }
+            continue;
+        }
+
+        if (!(debounced & mask)) {
+            continue;
+        }
+
+        // Held down and stable
+        if (button->held < 0xFFFF) {
+            if (++button->held == OS_EVENT_TICKS(OS_EVENT_LONG_MS)) {
+                os_pushEvent(OS_EVENT_LONG | mask, os_eventMicros());
+            }
+        }
+        if ((osRepeatButtons & mask) && osRepeatPeriod && !--button->repeat) {
+            button->repeat = osRepeatPeriod;
+            os_pushEvent(OS_EVENT_REPEAT | mask, os_eventMicros());
+        }
+    }
+
+    osDebounced = debounced;
+
+    if (osQueueTail != tail && osHook) {
+        osHook();
+    }
+}
+
+/*!
+ *  Takes the oldest event out of the queue. Does not block.
+ *
+ *  \return The event (OS_EVENT_* type | OS_BUTTON_* bit) or OS_EVENT_NONE.
+ */
+uint8_t os_getEvent(void) {
+    return os_getTimedEvent(NULL);
+}
+
+/*!
+ *  Takes the oldest event out of the queue. Does not block.
+ *
+ *  \param time  Receives the timestamp of the event in microseconds
+ *               (os_eventMicros), may be NULL.
+ *  \return      The event (OS_EVENT_* type | OS_BUTTON_* bit) or OS_EVENT_NONE.
+ */
+uint8_t os_getTimedEvent(uint32_t *time) {
+    uint8_t const head = osQueueHead;
+    uint8_t event;
+
+    if (head == osQueueTail) {
+        return OS_EVENT_NONE;
+    }
+
+    // The producers do not touch this slot until the read position moves on
+    event = osQueue[head];
+    if (time) {
+        *time = osQueueTime[head];
+    }
+    // The slot is read before the producer may reuse it
+    osQueueHead = (head + 1) & (OS_EVENT_QUEUE_SIZE - 1);
+    return event;
+}
+
+/*!
+ *  Drops all queued events, e.g. before a program starts that waits for
+ *  new input.
+ */
+void os_flushEvents(void) {
+    osQueueHead = osQueueTail;
+}
+
+/*!
+ *  \return The debounced button states in the format of os_getInput.
+ */
+uint8_t os_getButtons(void) {
+    return osDebounced;
+}
+
+/*!
+ *  Configures the auto-repeat. The first repeat event follows the press
+ *  after delayMs, then every periodMs while the button is held.
+ *
+ *  \param buttons   OS_BUTTON_* bits of the buttons that repeat.
+ *  \param delayMs   Delay until the first repeat event.
+ *  \param periodMs  Time between repeat events, 0 disables the repetition.
+ */
+void os_setRepeat(uint8_t buttons, uint16_t delayMs, uint16_t periodMs) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        osRepeatButtons = buttons;
+        osRepeatDelay = OS_EVENT_TICKS(delayMs);
+        osRepeatPeriod = periodMs ? OS_EVENT_TICKS(periodMs) : 0;
+    }
+}
+
+/*!
+ *  Sets the event hook. It is called from the ISR that queued new events,
+ *  e.g. to wake up a task that handles them. It has to be short.
+ *
+ *  \param hook  The hook or NULL.
+ */
+void os_setEventHook(OsEventHook hook) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        osHook = hook;
+    }
+}
+
+#if OS_EVENT_OWN_TIMER
+/*!
+ *  Tick of the button sampling.
+ */
+ISR(TIMER2_COMPA_vect) {
+    osTicks++;
+    os_eventTick();
+}
+#endif
+
+#if OS_EVENT_PCINT_MASK
+/*!
+ *  Pin change of a button. Reports the press of a button that was at rest
+ *  immediately and absorbs the following bouncing in the integrator.
+ */
+ISR(PCINT2_vect) {
+    uint32_t const time = os_eventMicros();
+    uint8_t const pressed = os_getInput() & OS_EVENT_BUTTONS & ~osDebounced;
+    uint8_t const tail = osQueueTail;
+    uint8_t i;
+    uint8_t mask;
+
+    for (i = 0, mask = 1; i < OS_EVENT_BUTTON_COUNT; i++, mask <<= 1) {
+        ButtonState *const button = &osButtons[i];
+
+        // Only a button at rest, otherwise the edge is bouncing
+        if (!(pressed & mask) || button->integrator) {
+            continue;
+        }
+
+        button->integrator = OS_EVENT_INTEGRATOR_MAX;
+        button->held = 0;
+        button->repeat = osRepeatDelay;
+        osDebounced |= mask;
+        os_pushEvent(OS_EVENT_PRESS | mask, time);
+    }
+
+    if (osQueueTail != tail && osHook) {
+        osHook();
+    }
+}
+#endif
@@ -1,5 +1,7 @@
 #include "os_input.h"
+#include "os_event.h"
 #include <avr/io.h>
+#include <avr/sleep.h>
 #include <stdint.h>
 
 /*! \file
@@ -74,32 +76,34 @@ void os_initInput() {
     // Set PORTC bits 7, 6, 1, 0 to 1  enable internal pull-ups
     //On AVR microcontrollers (like ATmega), setting a pin in PORTx to 1 while it's configured as an input (DDRx = 0) activates its internal pull-up resistor.
     PORTC |= 0b11000011;
+
+    // Start debouncing the buttons
+    os_initEvents();
 }
 
 
 /*!
- *  Waits in a loop until all buttons are released.
+ *  Waits until all buttons are released (debounced).
  *  
- *  Assumes that 0b00000001 represents the idle state (no button except C0 is pressed).
- *  C0 is ignored in detection and always considered 'pressed'.
+ *  C0 is not a button and therefore not part of the debounced states.
+ *  The CPU sleeps until the next tick of the debouncing in between.
  */
 void os_waitForNoInput() {
-    // Idle means only C0 active (bit 0 set)
-    while (os_getInput() != 0b00000001) {
-        // Keep waiting until all user-relevant buttons are unpressed
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    while (os_getButtons() != 0) {
+        sleep_mode();
     }
 }
 
 /*!
- *  Waits in a loop until any button is pressed.
+ *  Waits until any button is pressed (debounced).
  *  
- *  Will block as long as either:
- *    - No button is pressed (0b00000000)
- *    - Only C0 is active (0b00000001)
+ *  C0 is not a button and therefore not part of the debounced states.
+ *  The CPU sleeps until the next tick of the debouncing in between.
  */
 void os_waitForInput() {
-    // Wait while nothing or just C0 is pressed
-    while (os_getInput() == 0b00000000 || os_getInput() == 0b00000001) {
-        // Keep waiting until a real button is pressed
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    while (os_getButtons() == 0) {
+        sleep_mode();
     }
 }
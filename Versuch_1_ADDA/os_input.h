@@ -12,6 +12,33 @@
 #define _OS_INPUT_H
 
 #include <stdint.h>
+#include <avr/io.h>
+
+//----------------------------------------------------------------------------
+// Constants
+//----------------------------------------------------------------------------
+
+//! Bit of the DOWN button (C1) in the value of os_getInput
+#define OS_BUTTON_DOWN 0b00000010
+
+//! Bit of the UP button (C6) in the value of os_getInput
+#define OS_BUTTON_UP 0b00000100
+
+//! Bit of the ESC button (C7) in the value of os_getInput
+#define OS_BUTTON_ESC 0b00001000
+
+//----------------------------------------------------------------------------
+// Configuration of os_event
+//----------------------------------------------------------------------------
+
+//! Buttons on this board (C0 is used by the comparator)
+#define OS_EVENT_BUTTONS (OS_BUTTON_DOWN | OS_BUTTON_UP | OS_BUTTON_ESC)
+
+//! The buttons are sampled by Timer2 of os_event
+#define OS_EVENT_OWN_TIMER 1
+
+//! C1, C6 and C7 report presses by pin change interrupt (not the comparator on C0)
+#define OS_EVENT_PCINT_MASK ((1 << PCINT17) | (1 << PCINT22) | (1 << PCINT23))
 
 //----------------------------------------------------------------------------
 // Function headers
@@ -20,7 +47,7 @@
 //! Initializes the respective Pins for the buttons, i.e. sets DDR and Pull ups
 void os_initInput(void);
 
-//! Refreshes the button states
+//! Reads the raw button states (not debounced)
 uint8_t os_getInput(void);
 
 //! Waits for all buttons to be released
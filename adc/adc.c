@@ -1,20 +1,97 @@
 #include "adc.h"
+#include "latency.h"
+#include "timebase.h"
+#include "timelog.h"
+#include <avr/interrupt.h>
 #include <avr/io.h>
+#include <avr/pgmspace.h>
 #include <stdlib.h>
+#include <util/atomic.h>
 #include <util/delay.h>
 #include "lcd.h"
 
+//! MUX4:0 of the internal 1.1V bandgap
+#define ADC_MUX_BANDGAP 0x1E
+
+//! Steps of a bandgap measurement: none, first conversion, second conversion
+#define ADC_BANDGAP_IDLE 0
+#define ADC_BANDGAP_SETTLE 1
+#define ADC_BANDGAP_CONVERT 2
+
+//! Timer1 counts the compare of the next conversion has to be ahead of the
+//! counter when it is set (covers the check in the ISR)
+#define ADC_COMPARE_MARGIN 4
+
 //! Global variables
 uint16_t lastCaptured;
 
 uint16_t* bufferStart;
 uint8_t bufferSize;
-uint8_t bufferIndex;
+volatile uint8_t bufferIndex;
+
+//! Whether the ISR stores its samples
+static volatile bool adcRecording;
+
+//! Latest results of the ISR (raw and filtered, 0...1023)
+static volatile uint16_t adcRaw, adcFiltered;
+
+//! REFS bits of the ranges
+static const uint8_t adcRangeMux[ADC_RANGES] PROGMEM = {
+    _BV(REFS0), _BV(REFS1) | _BV(REFS0), _BV(REFS1)
+};
+
+//! Factor from a conversion to Q15 of 5V (<< 8): 32 * reference / 5V. The
+//! one of AVCC follows the measured supply (setAdcSupply).
+static uint16_t adcRangeScale[ADC_RANGES] = { 8192, 4194, 1802 };
+
+//! Q15 below which the range is selected: 80% of its top
+static const uint16_t adcRangeDown[ADC_RANGES] PROGMEM = { 0, 13407, 5761 };
+
+//! Upper bound for lcd_writeVoltage with 5V: 1023 * 5V / reference
+static uint16_t adcRangeBound[ADC_RANGES] = { 1023, 1998, 4650 };
+
+//! Supply voltage that adcRangeScale and adcRangeBound use for AVCC
+static uint16_t adcSupplyMv = ADC_SUPPLY_NOMINAL_MV;
+
+//! A bandgap conversion is requested, its progress (ADC_BANDGAP_*) and result
+static volatile bool adcBandgapRequest;
+static uint8_t adcBandgapStep;
+static volatile uint16_t adcBandgap;
+
+//! Range of the next conversion and whether it is selected automatically
+static volatile uint8_t adcRange;
+static volatile bool adcAutoRange;
+
+//! Timer1 counts the reference still needs to settle. Every discarded
+//! conversion takes one period off, so the number of conversions needs no
+//! division by the period.
+static uint32_t adcSettleLeft;
+
+//! Largest sample (Q15) and number of samples of the running range window
+static uint16_t adcRangeMax;
+static uint8_t adcRangeCount;
+
+//! Last valid conversion, tagged and in Q15 of the AVCC range
+static volatile uint16_t adcSample;
+static uint16_t adcCommon;
+
+//! Timer1 counts between two conversions
+static volatile uint16_t adcPeriod = ADC_US_TO_COUNTS(ADC_SAMPLE_PERIOD_US);
+
+//! Microseconds between two conversions
+static uint16_t adcPeriodUs = ADC_SAMPLE_PERIOD_US;
+
+//! Receives every sample
+static AdcSampleHook adcSampleHook;
+
+//! Filters applied to every sample
+static FilterChain adcFilter;
 
 /*! \brief This method initializes the necessary registers for using the ADC module. \n
  * Reference voltage:    internal \n
  * Input channel:        PORTA0 \n
- * Conversion frequency: 156kHz
+ * Conversion frequency: 156kHz \n
+ * Trigger:              Timer1 compare match B every ADC_SAMPLE_PERIOD_US
  */
 void initAdc(void) {
     // Init DDRA0 as input
@@ -24,30 +101,429 @@ void initAdc(void) {
     // Set up the ADC: Use internal reference voltage and select ADC0 as the input
     // REFS1:0 = 01 for internal reference voltage, ADLAR = 0 for right-adjusted result
     ADMUX = _BV(REFS0); // Set REFS0 bit for internal reference, REFS1 remains 0
+    adcRange = ADC_RANGE_AVCC;
+    adcAutoRange = false;
+
+    filter_clear(&adcFilter);
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        // Timer1 is normally running already (latency_init), it is shared and
+        // never reset here
+        if (!(TCCR1B & (_BV(CS12) | _BV(CS11) | _BV(CS10)))) {
+            TCCR1A = 0;
+            TCCR1B = _BV(CS11);
+        }
+        OCR1B = TCNT1 + adcPeriod;
+        TIFR1 = _BV(OCF1B);
 
-    // Configure ADC control settings
-    // Enable ADC (ADEN = 1), set ADC prescaler to 128 (ADPS2:0 = 111), disable interrupts and auto-triggering
-    ADCSRA = _BV(ADEN) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+        // Auto trigger source: Timer1 compare match B (ADTS2:0 = 101)
+        ADCSRB = (ADCSRB & ~(_BV(ADTS2) | _BV(ADTS1) | _BV(ADTS0))) | _BV(ADTS2) | _BV(ADTS0);
 
+        // Enable ADC (ADEN = 1), set ADC prescaler to 128 (ADPS2:0 = 111), enable interrupt and auto-triggering
+        ADCSRA = _BV(ADEN) | _BV(ADATE) | _BV(ADIE) | _BV(ADIF) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+    }
+    sei();
 }
 
-/*! \brief Executes one conversion of the ADC and returns its value.
+/*! \brief Sets the time between two conversions. Takes effect after the next conversion.
+ * Needs no division, so the rate controller and the capture call it from the ISR.
  *
- * \return The converted voltage (0 = 0V, 1023 = AVCC)
+ * \param us   Microseconds, values below ADC_MIN_PERIOD_US are raised to it.
+ */
+void setAdcSamplePeriod(uint16_t us) {
+    if (us < ADC_MIN_PERIOD_US) {
+        us = ADC_MIN_PERIOD_US;
+    }
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        adcPeriod = ADC_US_TO_COUNTS(us);
+        adcPeriodUs = us;
+    }
+}
+
+/*! \brief Returns the time between two conversions.
+ *
+ * \return Microseconds.
+ */
+uint16_t getAdcSamplePeriod(void) {
+    uint16_t us;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        us = adcPeriodUs;
+    }
+    return us;
+}
+
+/*! \brief Sets the sample hook. It runs in the ADC ISR and has to be short.
+ *
+ * \param hook The hook or NULL.
+ */
+void setAdcSampleHook(AdcSampleHook hook) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        adcSampleHook = hook;
+    }
+}
+
+/*! \brief Stops or resumes the conversions. While paused, Timer1 no longer
+ * triggers the ADC, so PA0 may be used as an output and no sample reaches
+ * the filters or the hook. Resuming makes PA0 an input without pull-up again
+ * and discards the first conversion.
+ *
+ * \param paused  True stops the conversions, false resumes them.
+ */
+void setAdcPaused(bool paused) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (paused) {
+            ADCSRA &= ~_BV(ADATE);
+        } else if (!(ADCSRA & _BV(ADATE))) {
+            DDRA &= ~_BV(PA0);
+            PORTA &= ~_BV(PA0);
+            adcSettleLeft = adcPeriod;
+            OCR1B = TCNT1 + adcPeriod;
+            TIFR1 = _BV(OCF1B);
+            ADCSRA |= _BV(ADATE);
+        }
+    }
+}
+
+/*! \brief Switches the reference for the next conversion and starts discarding
+ * conversions until it has settled. Interrupts have to be disabled.
+ *
+ * \param range ADC_RANGE_*.
+ */
+static void switchAdcRange(uint8_t range) {
+    if (range == adcRange) {
+        return;
+    }
+    adcRange = range;
+
+    // Always ADC0, a bandgap conversion in progress is repeated later
+    ADMUX = pgm_read_byte(&adcRangeMux[range]);
+    adcBandgapStep = ADC_BANDGAP_IDLE;
+    // Plus the conversion that may be running with the old reference
+    adcSettleLeft = ADC_US_TO_COUNTS(ADC_RANGE_SETTLE_US) + (uint32_t)adcPeriod;
+    adcRangeMax = 0;
+    adcRangeCount = 0;
+}
+
+/*! \brief Refers a sample of the AVCC range to 5V with the current supply, so
+ * a stored sample does not change with later supply measurements. Samples of
+ * the internal references are returned as they are. Interrupts have to be
+ * disabled.
+ *
+ * \param sample   A tagged sample (ADC_SAMPLE).
+ * \return         The sample to store.
+ */
+static uint16_t compensateAdcSample(uint16_t sample) {
+    uint16_t code;
+
+    if (ADC_SAMPLE_RANGE(sample) != ADC_RANGE_AVCC) {
+        return sample;
+    }
+    code = (((uint32_t)ADC_SAMPLE_CODE(sample) * adcRangeScale[ADC_RANGE_AVCC]) + 4096) >> 13;
+    return ADC_SAMPLE((code < 1023) ? code : 1023, ADC_RANGE_AVCC);
+}
+
+/*! \brief Selects a fixed reference and switches auto-ranging off.
+ *
+ * \param range ADC_RANGE_AVCC, ADC_RANGE_2V56 or ADC_RANGE_1V1.
+ */
+void setAdcRange(uint8_t range) {
+    if (range >= ADC_RANGES) {
+        return;
+    }
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        adcAutoRange = false;
+        switchAdcRange(range);
+    }
+}
+
+/*! \brief Switches auto-ranging on or off. Switching it off keeps the current range.
+ *
+ * \param on   True for auto-ranging.
+ */
+void setAdcAutoRange(bool on) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        adcAutoRange = on;
+        adcRangeMax = 0;
+        adcRangeCount = 0;
+    }
+}
+
+/*! \brief Returns whether the range is selected automatically.
+ *
+ * \return True for auto-ranging.
+ */
+bool isAdcAutoRange(void) {
+    return adcAutoRange;
+}
+
+/*! \brief Returns the range of the latest valid conversion.
+ *
+ * \return ADC_RANGE_*.
+ */
+uint8_t getAdcRange(void) {
+    return ADC_SAMPLE_RANGE(getAdcSample());
+}
+
+/*! \brief Returns the latest valid conversion with its range.
+ *
+ * \return The sample, see ADC_SAMPLE_CODE and ADC_SAMPLE_RANGE.
+ */
+uint16_t getAdcSample(void) {
+    uint16_t sample;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        sample = adcSample;
+    }
+    return sample;
+}
+
+/*! \brief Returns the value that lcd_writeVoltage needs as upper bound to show a
+ * conversion of the range in volts, e.g.
+ * lcd_writeVoltage(ADC_SAMPLE_CODE(s), getAdcRangeBound(ADC_SAMPLE_RANGE(s)), 5).
+ *
+ * \param range ADC_RANGE_*.
+ * \return      1023 * 5V / reference.
+ */
+uint16_t getAdcRangeBound(uint8_t range) {
+    uint16_t bound;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        bound = adcRangeBound[range < ADC_RANGES ? range : ADC_RANGE_AVCC];
+    }
+    return bound;
+}
+
+/*! \brief Lets the ISR measure the internal 1.1V bandgap against AVCC. The
+ * measurement takes the place of two samples as soon as the AVCC range is
+ * selected (the first conversion after switching the mux is discarded).
+ */
+void requestAdcBandgap(void) {
+    adcBandgapRequest = true;
+}
+
+/*! \brief Withdraws a bandgap request. A measurement in progress is aborted,
+ * its conversion in flight is discarded like one after a range switch.
+ */
+void cancelAdcBandgap(void) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        adcBandgapRequest = false;
+        if (adcBandgapStep != ADC_BANDGAP_IDLE) {
+            ADMUX = pgm_read_byte(&adcRangeMux[ADC_RANGE_AVCC]);
+            adcBandgapStep = ADC_BANDGAP_IDLE;
+            adcSettleLeft = adcPeriod;
+        }
+    }
+}
+
+/*! \brief Returns the result of the bandgap measurement and clears it.
+ *
+ * \return The conversion of the bandgap against AVCC, 0 while there is none.
+ */
+uint16_t getAdcBandgap(void) {
+    uint16_t code;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        code = adcBandgap;
+        adcBandgap = 0;
+    }
+    return code;
+}
+
+/*! \brief Sets the supply voltage (AVCC) that conversions of the AVCC range are
+ * scaled with. All values of the module stay in 0...1023 for 5V, so a
+ * conversion of a lower supply becomes smaller.
+ *
+ * \param mv    Millivolts, limited to ADC_SUPPLY_MIN_MV...ADC_SUPPLY_MAX_MV.
+ */
+void setAdcSupply(uint16_t mv) {
+    uint16_t scale, bound;
+
+    if (mv < ADC_SUPPLY_MIN_MV) {
+        mv = ADC_SUPPLY_MIN_MV;
+    } else if (mv > ADC_SUPPLY_MAX_MV) {
+        mv = ADC_SUPPLY_MAX_MV;
+    }
+
+    // The divisions are done here once, the ISR only multiplies
+    scale = ((uint32_t)8192 * mv + ADC_SUPPLY_NOMINAL_MV / 2) / ADC_SUPPLY_NOMINAL_MV;
+    bound = ((uint32_t)1023 * ADC_SUPPLY_NOMINAL_MV + mv / 2) / mv;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        adcRangeScale[ADC_RANGE_AVCC] = scale;
+        adcRangeBound[ADC_RANGE_AVCC] = bound;
+        adcSupplyMv = mv;
+    }
+}
+
+/*! \brief Returns the supply voltage that conversions are scaled with.
+ *
+ * \return Millivolts, ADC_SUPPLY_NOMINAL_MV until setAdcSupply is called.
+ */
+uint16_t getAdcSupply(void) {
+    uint16_t mv;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        mv = adcSupplyMv;
+    }
+    return mv;
+}
+
+/*! \brief Runs the steps of a bandgap measurement in the ISR: starts it after
+ * a valid sample, discards the first conversion and keeps the second one.
+ *
+ * \param code  The conversion that has just finished.
+ */
+static void updateAdcBandgap(uint16_t code) {
+    switch (adcBandgapStep) {
+        case ADC_BANDGAP_IDLE:
+            // Only between two valid samples against AVCC
+            if (adcBandgapRequest && !adcSettleLeft && adcRange == ADC_RANGE_AVCC) {
+                ADMUX = pgm_read_byte(&adcRangeMux[ADC_RANGE_AVCC]) | ADC_MUX_BANDGAP;
+                adcBandgapStep = ADC_BANDGAP_SETTLE;
+            }
+            break;
+        case ADC_BANDGAP_SETTLE:
+            adcBandgapStep = ADC_BANDGAP_CONVERT;
+            break;
+        default:
+            ADMUX = pgm_read_byte(&adcRangeMux[ADC_RANGE_AVCC]);
+            adcBandgap = code ? code : 1;
+            adcBandgapRequest = false;
+            adcBandgapStep = ADC_BANDGAP_IDLE;
+            break;
+    }
+}
+
+/*! \brief Selects the range for the following conversions. A conversion at
+ * the top of a small range switches to AVCC at once (one settling time
+ * instead of one per step), a window of small samples switches down one
+ * range. Runs in the ISR.
+ *
+ * \param code      The conversion.
+ * \param common    The conversion in Q15 of the AVCC range.
+ */
+static void updateAdcRange(uint16_t code, uint16_t common) {
+    uint8_t const range = adcRange;
+
+    if (code >= ADC_RANGE_CLIP && range != ADC_RANGE_AVCC) {
+        switchAdcRange(ADC_RANGE_AVCC);
+        return;
+    }
+
+    if (common > adcRangeMax) {
+        adcRangeMax = common;
+    }
+    if (++adcRangeCount >> ADC_RANGE_WINDOW_SHIFT) {
+        if (range + 1 < ADC_RANGES && adcRangeMax < pgm_read_word(&adcRangeDown[range + 1])) {
+            switchAdcRange(range + 1);
+        } else {
+            adcRangeMax = 0;
+            adcRangeCount = 0;
+        }
+    }
+}
+
+/*! \brief Returns the filter chain of the ISR. Stages have to be added or removed
+ * with interrupts disabled.
+ *
+ * \return The filter chain.
+ */
+FilterChain *getAdcFilter(void) {
+    return &adcFilter;
+}
+
+/*! \brief Returns the latest filtered conversion.
+ *
+ * \return The filtered voltage (0 = 0V, 1023 = AVCC)
  */
 uint16_t getAdcValue() {
-    // Start the conversion
-    ADCSRA |= _BV(ADSC); // Set ADSC bit in ADCSRA register to start the ADC conversion
+    uint16_t value;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        value = adcFiltered;
+    }
+    return value;
+}
+
+/*! \brief Returns the latest conversion before the filters.
+ *
+ * \return The converted voltage (0 = 0V, 1023 = AVCC)
+ */
+uint16_t getAdcRawValue(void) {
+    uint16_t value;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        value = adcRaw;
+    }
+    return value;
+}
 
-    // Wait until the conversion has finished (ADSC will be cleared when done)
-    while (ADCSRA & _BV(ADSC)) {} // Check if ADSC bit is still set
+/*! \brief A conversion has finished. Runs the filters and schedules the next trigger.
+ * The compare flag has to be cleared, the next rising edge of it starts the
+ * next conversion.
+ */
+ISR(ADC_vect) {
+    uint16_t const start = latency_now();
+    uint16_t const code = ADC;
+    uint16_t const previous = OCR1B;
+    uint16_t const period = adcPeriod;
+    uint16_t raw;
+    int16_t filtered;
+
+    OCR1B = previous + period;
+    TIFR1 = _BV(OCF1B);
+
+    // An ISR that starts late (at the shortest period only a few
+    // microseconds after the end of the conversion) could leave the compare
+    // in the past, and it would only match after Timer1 has wrapped (26ms).
+    // The next conversion is then started one period from now instead, a
+    // sample is skipped.
+    if ((uint16_t)(TCNT1 - previous) >= period - ADC_COMPARE_MARGIN) {
+        OCR1B = TCNT1 + period;
+    }
+
+    // While the reference settles or the bandgap is measured, the last
+    // valid sample is repeated
+    if (adcBandgapStep != ADC_BANDGAP_IDLE) {
+        updateAdcBandgap(code);
+    } else if (adcSettleLeft) {
+        adcSettleLeft = (adcSettleLeft > adcPeriod) ? adcSettleLeft - adcPeriod : 0;
+    } else {
+        uint8_t const range = adcRange;
+        uint32_t const common = ((uint32_t)code * adcRangeScale[range]) >> 8;
+
+        // Above 5V with a higher supply
+        adcCommon = (common < INT16_MAX) ? common : INT16_MAX;
+        adcSample = ADC_SAMPLE(code, range);
+        if (adcAutoRange) {
+            updateAdcRange(code, adcCommon);
+        }
+        updateAdcBandgap(code);
+    }
+
+    // The filters work in Q15 of 5V, the results are rounded back to 10 bit
+    // (without overflowing int) and limited, IIRs may overshoot
+    raw = (adcCommon + 16) >> 5;
+    if (raw > 1023) {
+        raw = 1023;
+    }
+    filtered = ((filter_run(&adcFilter, adcCommon) >> 4) + 1) >> 1;
+    if (filtered < 0) {
+        filtered = 0;
+    } else if (filtered > 1023) {
+        filtered = 1023;
+    }
+
+    adcRaw = raw;
+    adcFiltered = filtered;
 
-    // Store the result of the ADC conversion
-    lastCaptured = ADCL | ((uint16_t)ADCH << 8); // Combine the lower and upper 8 bits of the ADC result
+    if (adcRecording) {
+        if (bufferIndex < bufferSize && timelog_append(timebase_micros())) {
+            bufferStart[bufferIndex++] = compensateAdcSample(adcSample);
+        } else {
+            adcRecording = false;
+        }
+    }
 
-    // Return the ADC result
-    return lastCaptured;
+    if (adcSampleHook) {
+        adcSampleHook(raw, filtered);
+    }
 
+    latency_isrDone(start);
 }
 
 /*! \brief Returns the size of the buffer which stores voltage values.
@@ -87,14 +563,23 @@ void allocateBufferIfNeeded(void) {
 void storeVoltage(void) { //Messwert speichern
 	//Wenn Puffergrosse = 0, muss erst mit malloc allozieren
     allocateBufferIfNeeded();
+
+    // The buffer belongs to the ISR while it records
+    if (adcRecording) {
+        return;
+    }
 	
 	//bufferIndex: nachste freie Index im Puffer 
 	//Ist bufferIndex gleich oder grosser als puffergrosse, wird kein neuer Spannungswert gespeichert werden 
 	//Andernfalls zuletzt gemessene Spannungnswert 'lastCaptured' an diese Position gespeichert 
 		//Dann soll bufferIndex auch inkrementieren 
-        if (bufferIndex < bufferSize) {
-            // Get the latest ADC value
-            lastCaptured = getAdcValue();
+        // The time of the value is logged as well, a value without it is not stored
+        if (bufferIndex < bufferSize && timelog_append(timebase_micros())) {
+            // Get the latest conversion with its range, like the ISR records
+            // it, referred to 5V with the supply in effect now
+            ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+                lastCaptured = compensateAdcSample(adcSample);
+            }
             
             // Store the ADC value at the current bufferIndex position
             *(bufferStart + bufferIndex) = lastCaptured;
@@ -107,15 +592,83 @@ void storeVoltage(void) { //Messwert speichern
 /*! \brief Returns the voltage value with the passed index.
  *
  * \param ind   Index of the voltage value.
- * \return      The voltage value with index ind.
+ * \return      The voltage value with index ind (0...1023 for 5V, whatever its range).
  */
 uint16_t getStoredVoltage(uint8_t ind) {
+    uint16_t const sample = getStoredSample(ind);
+    uint8_t const range = ADC_SAMPLE_RANGE(sample);
+    uint16_t voltage;
+
+    // AVCC samples were referred to 5V when they were stored
+    if (range == ADC_RANGE_AVCC) {
+        return ADC_SAMPLE_CODE(sample);
+    }
+
+    // Scale to 5V: Q15 >> 5, rounded (the internal references do not
+    // depend on the supply)
+    voltage = (((uint32_t)ADC_SAMPLE_CODE(sample) * adcRangeScale[range]) + 4096) >> 13;
+    return (voltage < 1023) ? voltage : 1023;
+}
+
+/*! \brief Returns the voltage value with the passed index and its range.
+ *
+ * \param ind   Index of the voltage value.
+ * \return      The tagged sample (ADC_SAMPLE), 0 if the index is invalid.
+ */
+uint16_t getStoredSample(uint8_t ind) {
     // If the requested index is within the valid range
-    if (index < bufferIndex) {
+    if (ind < bufferIndex) {
         // Retrieve the voltage value stored at that index
-        uint16_t voltage = *(bufferStart + index);
-        return voltage;  // Return the stored voltage value
+        return *(bufferStart + ind);
     }
     // Return 0 if the index is invalid (out of range)
     return 0;
 }
+
+/*! \brief Clears the stored voltages and lets the ISR store every conversion
+ * (unfiltered, tagged with its range) with its time until the buffer or the
+ * time log is full.
+ */
+void startAdcRecording(void) {
+    allocateBufferIfNeeded();
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        bufferIndex = 0;
+        timelog_clear();
+        adcRecording = true;
+    }
+}
+
+/*! \brief Stops the recording, the stored voltages are kept.
+ */
+void stopAdcRecording(void) {
+    adcRecording = false;
+}
+
+/*! \brief Returns whether the ISR stores its samples.
+ *
+ * \return False when the recording has been stopped or the buffer is full.
+ */
+bool isAdcRecording(void) {
+    return adcRecording;
+}
+
+/*! \brief Returns the time a voltage was stored (by storeVoltage or a
+ * recording), relative to the first stored voltage.
+ *
+ * \param ind   Index of the voltage value.
+ * \return      Microseconds after the first voltage, 0 if the index is invalid.
+ */
+uint32_t getStoredTime(uint8_t ind) {
+    return timelog_elapsed(ind);
+}
+
+/*! \brief Finds a stored voltage by its time, see getStoredTime.
+ *
+ * \param us    Microseconds after the first voltage.
+ * \return      Index of the first voltage stored at or after that time,
+ *              getBufferIndex() if there is none.
+ */
+uint8_t findStoredTime(uint32_t us) {
+    return timelog_find(us);
+}
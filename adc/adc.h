@@ -1,6 +1,27 @@
 /*! \file
  *  \brief Analog digital converter module.
  *  Contains functionality to access the internal ADC of the microcontroller.
+ *  The conversions are started by compare match B of the free-running
+ *  Timer1 at a fixed rate, and every result runs through a filter chain in
+ *  the ADC interrupt.
+ *
+ *  The reference is AVCC (5V), the internal 2.56V or the internal 1.1V
+ *  reference. With auto-ranging, a conversion close to the top of a small
+ *  range switches to AVCC at once; when all samples of a window of
+ *  2^ADC_RANGE_WINDOW_SHIFT stay below 80% of the next smaller range, that
+ *  range is selected. After a switch, the reference (and the
+ *  capacitor at AREF) needs ADC_RANGE_SETTLE_US to settle; the conversions
+ *  in that time are discarded and the last valid sample is repeated, so the
+ *  sample stream keeps its timing. The filters get every sample scaled to
+ *  the AVCC range in Q15, which keeps up to 5 more bits of a small range;
+ *  getAdcValue and the sample hook still use 0...1023 for 5V. The stored
+ *  voltages are tagged with their range (ADC_SAMPLE); those of the AVCC
+ *  range are referred to 5V with the supply at the time they were stored.
+ *
+ *  Conversions against AVCC are scaled with the supply voltage that was
+ *  last set with setAdcSupply, so all values refer to 5V even if the
+ *  supply differs. The supply is measured by converting the internal
+ *  bandgap (requestAdcBandgap, see supply.h).
  *
  *  \author   Lehrstuhl fE Informatik 11 - RWTH Aachen
  *  \date     2013
@@ -10,14 +31,117 @@
 #ifndef _ADC_H
 #define _ADC_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
+#include "filter.h"
+
+//! Default time between two conversions in microseconds (1kHz)
+#define ADC_SAMPLE_PERIOD_US 1000
+
+//! Shortest time between two conversions (13.5 ADC clocks at 156kHz plus the ISR)
+#define ADC_MIN_PERIOD_US 90
+
+//! Reference AVCC (5V)
+#define ADC_RANGE_AVCC 0
+
+//! Internal reference 2.56V
+#define ADC_RANGE_2V56 1
+
+//! Internal reference 1.1V
+#define ADC_RANGE_1V1 2
+
+//! Number of ranges
+#define ADC_RANGES 3
+
+//! Conversions from this value on switch to AVCC
+#define ADC_RANGE_CLIP 1000
+
+//! Samples per decision for a smaller range are 2^ADC_RANGE_WINDOW_SHIFT
+#define ADC_RANGE_WINDOW_SHIFT 6
+
+//! Settling time of the reference after a switch (AREF with 100nF, estimated)
+#define ADC_RANGE_SETTLE_US 5000
+
+//! Supply voltage that conversions of the AVCC range are scaled with until it is measured
+#define ADC_SUPPLY_NOMINAL_MV 5000
+
+//! Limits of a measured supply voltage
+#define ADC_SUPPLY_MIN_MV 4000
+#define ADC_SUPPLY_MAX_MV 5500
+
+//! A conversion tagged with its range
+#define ADC_SAMPLE(code, range) ((code) | ((uint16_t)(range) << 12))
+
+//! The conversion result (0...1023) of a tagged sample
+#define ADC_SAMPLE_CODE(sample) ((sample) & 0x03FF)
+
+//! The range of a tagged sample
+#define ADC_SAMPLE_RANGE(sample) ((sample) >> 12)
+
+//! Converts microseconds to Timer1 counts (prescaler 8)
+#define ADC_US_TO_COUNTS(us) ((uint16_t)((uint32_t)(us) * (F_CPU / 1000000UL) / 8))
+
+//! Called by the ADC ISR with every sample before and after the filters (0...1023)
+typedef void (*AdcSampleHook)(uint16_t raw, uint16_t filtered);
+
 //! This method initializes the necessary registers for using the ADC module.
 void initAdc(void);
 
-//! Executes one conversion of the ADC and returns its value.
+//! Returns the latest filtered value of the ADC (0...1023) without waiting.
 uint16_t getAdcValue();
 
+//! Returns the latest unfiltered value of the ADC (0...1023).
+uint16_t getAdcRawValue(void);
+
+//! Sets the time between two conversions in microseconds (at least ADC_MIN_PERIOD_US).
+void setAdcSamplePeriod(uint16_t us);
+
+//! Returns the time between two conversions in microseconds.
+uint16_t getAdcSamplePeriod(void);
+
+//! Sets a function that is called (in ISR context) with every sample, or NULL.
+void setAdcSampleHook(AdcSampleHook hook);
+
+//! Stops the conversions (e.g. while PA0 drives an LED) or resumes them.
+void setAdcPaused(bool paused);
+
+//! Selects a fixed reference (ADC_RANGE_*), auto-ranging is switched off.
+void setAdcRange(uint8_t range);
+
+//! Switches auto-ranging on or off.
+void setAdcAutoRange(bool on);
+
+//! Returns whether auto-ranging is on.
+bool isAdcAutoRange(void);
+
+//! Returns the range of the latest conversion.
+uint8_t getAdcRange(void);
+
+//! Returns the latest conversion tagged with its range (ADC_SAMPLE).
+uint16_t getAdcSample(void);
+
+//! Returns the upper bound for lcd_writeVoltage(code, bound, 5) of a range.
+uint16_t getAdcRangeBound(uint8_t range);
+
+//! Lets the ISR measure the 1.1V bandgap against AVCC once (in place of two samples).
+void requestAdcBandgap(void);
+
+//! Withdraws a bandgap request and aborts a measurement that is in progress.
+void cancelAdcBandgap(void);
+
+//! Returns the result of the last bandgap measurement and clears it, 0 while there is none.
+uint16_t getAdcBandgap(void);
+
+//! Sets the measured supply voltage in millivolts that conversions against AVCC are scaled with.
+void setAdcSupply(uint16_t mv);
+
+//! Returns the supply voltage in millivolts that conversions are scaled with.
+uint16_t getAdcSupply(void);
+
+//! Returns the filter chain that the ADC ISR runs on every sample (change it with interrupts disabled).
+FilterChain *getAdcFilter(void);
+
 //! Returns the size of the buffer which stores voltage values.
 uint8_t getBufferSize();
 
@@ -27,7 +151,25 @@ uint8_t getBufferIndex();
 //! Stores the last captured voltage.
 void storeVoltage(void);
 
-//! Returns the voltage value with the passed index.
+//! Returns the voltage value with the passed index (0...1023 for 5V).
 uint16_t getStoredVoltage(uint8_t ind);
 
+//! Returns the stored voltage with the passed index tagged with its range (ADC_SAMPLE).
+uint16_t getStoredSample(uint8_t ind);
+
+//! Clears the stored voltages and stores every following conversion (tagged) until the buffer is full.
+void startAdcRecording(void);
+
+//! Stops storing the samples of the ISR.
+void stopAdcRecording(void);
+
+//! Returns whether the samples of the ISR are being stored.
+bool isAdcRecording(void);
+
+//! Returns the time of a stored voltage in microseconds after the first one (see timelog.h).
+uint32_t getStoredTime(uint8_t ind);
+
+//! Returns the index of the first stored voltage at or after a time in microseconds after the first one.
+uint8_t findStoredTime(uint32_t us);
+
 #endif
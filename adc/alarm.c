@@ -0,0 +1,188 @@
+#include "alarm.h"
+#include "led.h"
+#include "timebase.h"
+
+#include <avr/io.h>
+#include <util/atomic.h>
+
+/*! \file
+ *  Window comparator with hysteresis, minimum duration and event log.
+ */
+
+//! Active settings
+static AlarmConfig alarmConfig;
+
+//! ALARM_NONE, ALARM_HIGH or ALARM_LOW
+static volatile uint8_t alarmState;
+
+//! Whether the alarm LED is driven
+static volatile bool alarmArmed;
+
+//! Samples in a row outside of the window
+static uint8_t alarmOutside;
+
+//! Ring buffer of the events and number of events since the start
+static AlarmEvent alarmLog[ALARM_LOG_SIZE];
+static volatile uint16_t alarmCount;
+
+/*!
+ *  Logs an event and switches the LED if the alarm is armed. Runs with
+ *  interrupts disabled.
+ *
+ *  \param type   ALARM_HIGH, ALARM_LOW or ALARM_CLEAR.
+ *  \param value  The sample.
+ */
+static void alarm_change(uint8_t type, uint16_t value) {
+    AlarmEvent *const event = &alarmLog[alarmCount & (ALARM_LOG_SIZE - 1)];
+
+    // The LED first, it is the reaction that matters
+    if (type == ALARM_CLEAR) {
+        if (alarmArmed) {
+            ALARM_PORT |= (1 << ALARM_PIN);
+        }
+        alarmState = ALARM_NONE;
+    } else {
+        if (alarmArmed) {
+            ALARM_PORT &= ~(1 << ALARM_PIN);
+        }
+        alarmState = type;
+    }
+
+    event->type = type;
+    event->value = value;
+    event->time = timebase_micros();
+    alarmCount++;
+}
+
+/*!
+ *  Clears the log and sets the window. The LED stays as it is, see
+ *  alarm_arm.
+ *
+ *  \param config  The settings.
+ */
+void alarm_init(AlarmConfig const *config) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        alarmCount = 0;
+    }
+    alarm_configure(config);
+}
+
+/*!
+ *  Arms or disarms the alarm LED. Armed, the LED is reserved (the LED bar
+ *  is initialized again without it) and shows the current state at once.
+ *  Disarmed, it is switched off and belongs to the bar again from the
+ *  next initLedBar on.
+ *
+ *  \param armed  True to drive the LED.
+ */
+void alarm_arm(bool armed) {
+    if (armed) {
+        reservedLedMask |= ALARM_LED_MASK;
+        initLedBar();
+
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            if (alarmState == ALARM_NONE) {
+                ALARM_PORT |= (1 << ALARM_PIN);
+            } else {
+                ALARM_PORT &= ~(1 << ALARM_PIN);
+            }
+            ALARM_DDR |= (1 << ALARM_PIN);
+            alarmArmed = true;
+        }
+    } else {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            alarmArmed = false;
+            ALARM_PORT |= (1 << ALARM_PIN);
+        }
+        reservedLedMask &= ~ALARM_LED_MASK;
+    }
+}
+
+/*!
+ *  Changes the window. A running alarm ends without an event, the LED is
+ *  switched off.
+ *
+ *  \param config  The settings.
+ */
+void alarm_configure(AlarmConfig const *config) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        alarmConfig = *config;
+        if (!alarmConfig.minSamples) {
+            alarmConfig.minSamples = 1;
+        }
+        alarmOutside = 0;
+        alarmState = ALARM_NONE;
+        if (alarmArmed) {
+            ALARM_PORT |= (1 << ALARM_PIN);
+        }
+    }
+}
+
+/*!
+ *  \param config  Receives the current settings.
+ */
+void alarm_getConfig(AlarmConfig *config) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        *config = alarmConfig;
+    }
+}
+
+/*!
+ *  \return ALARM_NONE, ALARM_HIGH or ALARM_LOW.
+ */
+uint8_t alarm_state(void) {
+    return alarmState;
+}
+
+/*!
+ *  \return The number of events since alarm_init. Only the last
+ *          ALARM_LOG_SIZE of them are kept.
+ */
+uint16_t alarm_eventCount(void) {
+    uint16_t count;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        count = alarmCount;
+    }
+    return count;
+}
+
+/*!
+ *  Reads an event of the log.
+ *
+ *  \param age    0 for the newest event, 1 for the one before, ...
+ *  \param event  Receives the event.
+ *  \return       False if there is no such event (any more).
+ */
+bool alarm_getEvent(uint8_t age, AlarmEvent *event) {
+    bool found = false;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (age < ALARM_LOG_SIZE && age < alarmCount) {
+            *event = alarmLog[(alarmCount - 1 - age) & (ALARM_LOG_SIZE - 1)];
+            found = true;
+        }
+    }
+    return found;
+}
+
+/*!
+ *  Compares a sample with the window. Runs in the ADC ISR.
+ *
+ *  \param sample  The sample (0...1023).
+ */
+void alarm_sample(uint16_t sample) {
+    uint8_t const state = alarmState;
+
+    if (state == ALARM_NONE) {
+        if (sample > alarmConfig.high || sample < alarmConfig.low) {
+            if (++alarmOutside >= alarmConfig.minSamples) {
+                alarmOutside = 0;
+                alarm_change(sample > alarmConfig.high ? ALARM_HIGH : ALARM_LOW, sample);
+            }
+        } else {
+            alarmOutside = 0;
+        }
+    } else if (state == ALARM_HIGH ? (sample + alarmConfig.hysteresis <= alarmConfig.high)
+                                   : (sample >= alarmConfig.low + alarmConfig.hysteresis)) {
+        alarm_change(ALARM_CLEAR, sample);
+    }
+}
@@ -0,0 +1,106 @@
+/*! \file
+ *  \brief Window comparator on the ADC samples.
+ *
+ *  Every sample is compared with a window [low, high] in the ADC ISR, right
+ *  after the conversion has finished. A sample outside of the window counts
+ *  towards the minimum duration; when minSamples samples in a row have been
+ *  outside, the alarm fires: the alarm LED is switched on in the same ISR
+ *  and an event with the value and a timestamp is logged. The alarm clears
+ *  (LED off, event logged) once a sample is back inside the window by the
+ *  hysteresis, so a signal close to a threshold does not toggle it.
+ *
+ *  The comparator gets the unfiltered samples, so the filter chain adds no
+ *  delay in samples; the minimum duration takes the place of a filter
+ *  against single outliers. The reaction time is bounded by the ADC: at
+ *  most one sample period plus the conversion (13.5 ADC clocks, 87us) plus
+ *  the ISR up to the comparator (the filters run before the hook, below
+ *  50us at the default chain), on top of the minimum duration. The UI
+ *  refresh rate does not matter.
+ *
+ *  The bound only holds while the ADC delivers new conversions. Whenever
+ *  the ISR repeats the last valid sample, the comparator is blind:
+ *    - for two sample periods per supply measurement (see supply.h), every
+ *      SUPPLY_INTERVAL_MS; the supply is paused while the alarm is armed,
+ *      so this only applies to the programs that do not arm it,
+ *    - for ADC_RANGE_SETTLE_US (5ms) after every range switch: once when a
+ *      range is selected by hand, and on every switch with auto-ranging
+ *      (the default, a fixed AVCC range, never switches),
+ *    - while the ADC is paused (setAdcPaused, during the binary clock).
+ *  A conversion skipped by a late ISR (only close to ADC_MIN_PERIOD_US)
+ *  adds one sample period.
+ *
+ *  The alarm LED is LED 15 of the bar (PD7, low active). The comparator and
+ *  the log always run, but the LED is only driven while the alarm is armed
+ *  (alarm_arm); only then is it reserved, so the bar does not drive it.
+ *  Programs that do not arm the alarm keep all of their LEDs.
+ */
+
+#ifndef _ALARM_H
+#define _ALARM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//! Port, data direction register and pin of the alarm LED (low active)
+#define ALARM_PORT PORTD
+#define ALARM_DDR DDRD
+#define ALARM_PIN PD7
+
+//! Bit of the alarm LED in the masks of the LED bar
+#define ALARM_LED_MASK 0x8000
+
+//! Logged events (power of 2), the oldest ones are overwritten
+#define ALARM_LOG_SIZE 8
+
+//! No alarm (sample inside the window)
+#define ALARM_NONE 0
+
+//! The samples have been above the high threshold
+#define ALARM_HIGH 1
+
+//! The samples have been below the low threshold
+#define ALARM_LOW 2
+
+//! The samples are back inside the window
+#define ALARM_CLEAR 3
+
+//! Settings of the comparator (0...1023)
+typedef struct {
+    uint16_t low;        //!< Lowest value inside the window
+    uint16_t high;       //!< Highest value inside the window
+    uint16_t hysteresis; //!< Distance into the window that clears an alarm
+    uint8_t minSamples;  //!< Samples in a row outside of the window that fire the alarm (>= 1)
+} AlarmConfig;
+
+//! A logged change of the alarm
+typedef struct {
+    uint8_t type;  //!< ALARM_HIGH, ALARM_LOW or ALARM_CLEAR
+    uint16_t value; //!< Sample that caused the change
+    uint32_t time;  //!< timebase_micros() of the change
+} AlarmEvent;
+
+//! Clears the log and sets the window (the comparator is enabled, the LED is not armed)
+void alarm_init(AlarmConfig const *config);
+
+//! Takes the alarm LED from the LED bar and drives it (true) or gives it back (false)
+void alarm_arm(bool armed);
+
+//! Changes the window, a running alarm is cleared
+void alarm_configure(AlarmConfig const *config);
+
+//! Returns the current settings
+void alarm_getConfig(AlarmConfig *config);
+
+//! Returns ALARM_NONE, ALARM_HIGH or ALARM_LOW
+uint8_t alarm_state(void);
+
+//! Returns the number of logged events since alarm_init (wraps)
+uint16_t alarm_eventCount(void);
+
+//! Reads a logged event, 0 is the newest; false if it is not in the log
+bool alarm_getEvent(uint8_t age, AlarmEvent *event);
+
+//! Compares a sample with the window, called by the ADC ISR
+void alarm_sample(uint16_t sample);
+
+#endif
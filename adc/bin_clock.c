@@ -1,110 +1,140 @@
 #include "bin_clock.h"
+#include "timebase.h"
 #include <avr/io.h>
-#include <avr/interrupt.h>
+#include <util/atomic.h>
 
-//! Global variables
-uint16_t milisec;
-uint8_t sec;
-uint8_t minute;
-uint8_t hour; 
+/*!
+ *  Increments two packed BCD digits.
+ *  \internal
+ */
+static inline uint8_t bcdIncrement(uint8_t bcd) {
+    bcd++;
+    if ((bcd & 0x0F) == 0x0A) {
+        bcd += 0x06; // Carry into the tens digit
+    }
+    return bcd;
+}
+
+//! Current time, only written by initClock and the timebase ISR
+static ClockTime clockTime;
+
+//! Incremented on every change of clockTime (see getTime)
+static volatile uint8_t clockSequence;
+
+/*!
+ *  Copies the current time without turning off interrupts. The ISR cannot
+ *  be interrupted by the caller, so if the sequence counter is unchanged
+ *  after the copy, no update happened in between and the copy is consistent.
+ *  Otherwise (at most once per 10ms) the copy is repeated.
+ *
+ *  \param time  Receives the current time.
+ */
+void getTime(ClockTime *time) {
+    uint8_t sequence;
+    do {
+        sequence = clockSequence;
+        *time = *(volatile ClockTime *)&clockTime;
+    } while (sequence != clockSequence);
+}
 
 /*!
  * \return The milliseconds counter of the current time.
  */
 uint16_t getMilliseconds() {
-    return milisec;
+    // 16 bit read is not atomic
+    ClockTime time;
+    getTime(&time);
+    return time.milliseconds;
 }
 
 /*!
  * \return The seconds counter of the current time.
  */
 uint8_t getSeconds() {
-    return sec;
+    return *(volatile uint8_t *)&clockTime.seconds;
 }
 
 /*!
  * \return The minutes counter of the current time.
  */
 uint8_t getMinutes() {
-    return minute;
+    return *(volatile uint8_t *)&clockTime.minutes;
 }
 
 /*!
  * \return The hour counter of the current time.
  */
 uint8_t getHours() {
-    return hour;
+    return *(volatile uint8_t *)&clockTime.hours;
 }
 
 /*!
- *  Initializes the binary clock (ISR and global variables)
+ *  Initializes the binary clock (timebase and global variables)
  */
 void initClock(void) {
-    // Set timer mode to CTC
-    TCCR0A &= ~(1 << WGM00);
-    TCCR0A |= (1 << WGM01);
-    TCCR0B &= ~(1 << WGM02);
-
-    // Set prescaler to 1024
-    TCCR0B |= (1 << CS02) | (1 << CS00);
-    TCCR0B &= ~(1 << CS01);
-
-    // Set compare register to 195 -> match every 10ms
-    OCR0A = 195;
-
-    // Init variables
-	// (1024/{20*10^6}) * 195 = 0,01sec
-    // Initialize time-related variables with default values
-    milisec = 0b00000000;  // Milliseconds set to 0
-    sec = 0b00000000;      // Seconds set to 0
-    minute = 0b00000000;   // Minutes set to 0 (test, can change later)
-    hour = 0b00001100;     // Start time set to 12:00 (in binary for 12)
-
-    // Avoid starting with 0:00 - 0:59 for the initial time setup
-
-
-    // Enable timer and global interrupts
-    TIMSK0 |= (1 << OCIE0A);
-    sei(); //Global Interrupt 
+    // The clock is advanced every 10ms by the drift-free Timer0 timebase
+    timebase_init();
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        // Initialize time-related variables with default values
+        clockTime.milliseconds = 0b00000000;  // Milliseconds set to 0
+        clockTime.seconds = 0b00000000;       // Seconds set to 0
+        clockTime.minutes = 0b00000000;       // Minutes set to 0 (test, can change later)
+        clockTime.hours = 0b00001100;         // Start time set to 12:00 (in binary for 12)
+
+        // Same time as packed BCD digits for the display
+        clockTime.bcdCentiseconds = 0x00;
+        clockTime.bcdSeconds = 0x00;
+        clockTime.bcdMinutes = 0x00;
+        clockTime.bcdHours = 0x12;
+
+        // Avoid starting with 0:00 - 0:59 for the initial time setup
+        clockSequence++;
+    }
 }
 
 /*!
- *  Updates the global variables to get a valid 12h-time
+ *  Updates the global variables to get a valid 12h-time.
+ *  Called every 10ms from the timebase ISR.
  */
 void updateClock(void) {
-
-        // Increase milliseconds by 10 each time this function is called
-        milisec += 10;  // Increment milliseconds by 10 (in decimal)
-    
-       // Check if milliseconds hit 1000 (1 second)
-    if (milisec >= 1000) {
-        milisec = 0;  // Reset milliseconds
-        sec++;        // Increment seconds
+    ClockTime *const t = &clockTime;
+
+    // Increase milliseconds by 10 each time this function is called
+    // The BCD digits are kept in step, a carry only happens on a rollover
+    t->milliseconds += 10;
+    t->bcdCentiseconds = bcdIncrement(t->bcdCentiseconds);
+
+    // Check if milliseconds hit 1000 (1 second)
+    if (t->milliseconds >= 1000) {
+        t->milliseconds = 0;  // Reset milliseconds
+        t->bcdCentiseconds = 0x00;
+        t->seconds++;         // Increment seconds
+        t->bcdSeconds = bcdIncrement(t->bcdSeconds);
     }
 
     // Check if seconds hit 60
-    if (sec >= 60) {
-        sec = 0;      // Reset seconds
-        minute++;     // Increment minutes
+    if (t->seconds >= 60) {
+        t->seconds = 0;       // Reset seconds
+        t->bcdSeconds = 0x00;
+        t->minutes++;         // Increment minutes
+        t->bcdMinutes = bcdIncrement(t->bcdMinutes);
     }
 
     // Check if minutes hit 60
-    if (minute >= 60) {
-        minute = 0;   // Reset minutes
-        hour++;       // Increment hours
+    if (t->minutes >= 60) {
+        t->minutes = 0;       // Reset minutes
+        t->bcdMinutes = 0x00;
+        t->hours++;           // Increment hours
+        t->bcdHours = bcdIncrement(t->bcdHours);
     }
 
     // Check if hours hit 13 (to avoid 0:00 - 0:59)
-    if (hour >= 13) {
-        hour = 1;     // Reset hours to 1
+    if (t->hours >= 13) {
+        t->hours = 1;         // Reset hours to 1
+        t->bcdHours = 0x01;
     }
 
-    
-}
-
-/*!
- *  ISR to increase second-counter of the clock
- */
-ISR(TIMER0_COMPA_vect) {
-    updateClock();
+    // Publish the new time for getTime
+    clockSequence++;
 }
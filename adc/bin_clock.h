@@ -12,19 +12,37 @@
 
 #include <stdint.h>
 
-//! Initializes the binary clock (ISR and global variables)
+//! Packed time of the binary clock
+typedef struct {
+    uint16_t milliseconds;   //!< 0...990 in steps of 10
+    uint8_t seconds;         //!< 0...59
+    uint8_t minutes;         //!< 0...59
+    uint8_t hours;           //!< 1...12
+    uint8_t bcdCentiseconds; //!< Milliseconds / 10 as packed BCD (0x00...0x99)
+    uint8_t bcdSeconds;      //!< Seconds as packed BCD (0x00...0x59)
+    uint8_t bcdMinutes;      //!< Minutes as packed BCD (0x00...0x59)
+    uint8_t bcdHours;        //!< Hours as packed BCD (0x01...0x12)
+} ClockTime;
+
+//! Initializes the binary clock (timebase and global variables)
 void initClock(void);
 
+//! Advances the clock by 10ms (called by the timebase ISR)
+void updateClock(void);
+
+//! Copies the current time consistently (no torn reads at rollovers)
+void getTime(ClockTime *time);
+
 //! Returns the milliseconds counter of the current time.
-uint16_t getTimeMilliseconds();
+uint16_t getMilliseconds(void);
 
 //! Returns the seconds counter of the current time.
-uint8_t getTimeSeconds();
+uint8_t getSeconds(void);
 
 //! Returns the minutes counter of the current time.
-uint8_t getTimeMinutes();
+uint8_t getMinutes(void);
 
 //! Returns the hour counter of the current time.
-uint8_t getTimeHours();
+uint8_t getHours(void);
 
 #endif
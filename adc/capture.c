@@ -0,0 +1,193 @@
+#include "capture.h"
+#include "adc.h"
+
+#include <util/atomic.h>
+
+/*! \file
+ *  Ring buffer capture with a level trigger.
+ */
+
+//! The samples, oldest at captureHead once the capture is done
+static uint16_t captureBuffer[CAPTURE_SIZE];
+
+//! Settings for the next capture
+static CaptureConfig captureNext;
+
+//! Settings of the running or frozen capture
+static CaptureConfig captureActive;
+
+//! CAPTURE_*
+static volatile uint8_t captureState;
+
+//! Next position to be written
+static uint8_t captureHead;
+
+//! Samples stored before the current one, up to the pre-trigger count
+static uint8_t captureFilled;
+
+//! Whether the signal has been beyond the hysteresis (trigger enabled)
+static bool capturePrimed;
+
+//! Level that enables the trigger again
+static uint16_t captureRearm;
+
+//! Samples still to be stored after the trigger
+static uint16_t captureRemaining;
+
+//! Sample period of the ADC before the capture was armed
+static uint16_t captureSavedPeriod;
+
+/*!
+ *  Stops a running capture and sets the default settings: rising edge at
+ *  half the range, a quarter of the buffer before the trigger.
+ */
+void capture_init(void) {
+    capture_stop();
+    captureNext.level = 512;
+    captureNext.hysteresis = 16;
+    captureNext.edge = CAPTURE_RISING;
+    captureNext.preTrigger = CAPTURE_SIZE / 4;
+    captureNext.periodUs = CAPTURE_PERIOD_US;
+}
+
+/*!
+ *  \return The settings of the next capture, may be changed at any time.
+ */
+CaptureConfig *capture_config(void) {
+    return &captureNext;
+}
+
+/*!
+ *  Clears the buffer, switches the ADC to the capture rate and waits for
+ *  the trigger.
+ */
+void capture_arm(void) {
+    capture_stop();
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        captureActive = captureNext;
+#if CAPTURE_SIZE < 256
+        if (captureActive.preTrigger >= CAPTURE_SIZE) {
+            captureActive.preTrigger = CAPTURE_SIZE - 1;
+        }
+#endif
+
+        if (captureActive.edge == CAPTURE_RISING) {
+            captureRearm = (captureActive.level > captureActive.hysteresis) ? captureActive.level - captureActive.hysteresis : 0;
+        } else {
+            captureRearm = captureActive.level + captureActive.hysteresis;
+        }
+
+        captureHead = 0;
+        captureFilled = 0;
+        capturePrimed = false;
+        captureSavedPeriod = getAdcSamplePeriod();
+        setAdcSamplePeriod(captureActive.periodUs);
+        captureState = CAPTURE_ARMED;
+    }
+}
+
+/*!
+ *  Freezes the buffer and restores the sample rate of the ADC.
+ *
+ *  \param state  CAPTURE_DONE or CAPTURE_IDLE.
+ */
+static void capture_finish(uint8_t state) {
+    captureState = state;
+    setAdcSamplePeriod(captureSavedPeriod);
+}
+
+/*!
+ *  Stops a capture that is armed or triggered. A frozen capture stays
+ *  available.
+ */
+void capture_stop(void) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (captureState == CAPTURE_ARMED || captureState == CAPTURE_TRIGGERED) {
+            capture_finish(CAPTURE_IDLE);
+        }
+    }
+}
+
+/*!
+ *  \return The state of the capture (CAPTURE_*).
+ */
+uint8_t capture_state(void) {
+    return captureState;
+}
+
+/*!
+ *  Returns a sample of the frozen buffer.
+ *
+ *  \param index  0 (oldest) ... CAPTURE_SIZE - 1 (newest).
+ *  \return       The sample, 0 if the capture is not done.
+ */
+uint16_t capture_get(uint8_t index) {
+    if (captureState != CAPTURE_DONE) {
+        return 0;
+    }
+    return captureBuffer[(uint8_t)(captureHead + index) & (CAPTURE_SIZE - 1)];
+}
+
+/*!
+ *  \return The index of the trigger sample in the frozen buffer.
+ */
+uint8_t capture_triggerIndex(void) {
+    return captureActive.preTrigger;
+}
+
+/*!
+ *  Converts an index of the frozen buffer to the time of the sample.
+ *
+ *  \param index  Index of the sample.
+ *  \return       Microseconds relative to the trigger (negative: before).
+ */
+int32_t capture_time(uint8_t index) {
+    return ((int16_t)index - captureActive.preTrigger) * (int32_t)captureActive.periodUs;
+}
+
+/*!
+ *  Stores a sample and evaluates the trigger. Runs in the ADC ISR.
+ *
+ *  \param sample  The sample (0...1023).
+ */
+void capture_sample(uint16_t sample) {
+    uint8_t const state = captureState;
+    bool edge;
+
+    if (state != CAPTURE_ARMED && state != CAPTURE_TRIGGERED) {
+        return;
+    }
+
+    captureBuffer[captureHead] = sample;
+    captureHead = (captureHead + 1) & (CAPTURE_SIZE - 1);
+
+    if (state == CAPTURE_TRIGGERED) {
+        if (!--captureRemaining) {
+            capture_finish(CAPTURE_DONE);
+        }
+        return;
+    }
+
+    // An edge is a crossing of the level after the signal was beyond the
+    // hysteresis on the other side
+    edge = false;
+    if (captureActive.edge == CAPTURE_RISING ? (sample <= captureRearm) : (sample >= captureRearm)) {
+        capturePrimed = true;
+    } else if (capturePrimed && (captureActive.edge == CAPTURE_RISING ? (sample >= captureActive.level) : (sample <= captureActive.level))) {
+        capturePrimed = false;
+        edge = true;
+    }
+
+    // Edges are ignored until the pre-trigger part is complete
+    if (captureFilled < captureActive.preTrigger) {
+        captureFilled++;
+    } else if (edge) {
+        captureRemaining = CAPTURE_SIZE - 1 - captureActive.preTrigger;
+        if (captureRemaining) {
+            captureState = CAPTURE_TRIGGERED;
+        } else {
+            capture_finish(CAPTURE_DONE);
+        }
+    }
+}
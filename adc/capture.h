@@ -0,0 +1,88 @@
+/*! \file
+ *  \brief Triggered capture of the ADC samples.
+ *
+ *  Works like the single shot mode of an oscilloscope. While armed, every
+ *  sample goes into a ring buffer of CAPTURE_SIZE samples. The trigger
+ *  fires when the signal crosses the level in the configured direction
+ *  after it had been beyond the hysteresis on the other side, so noise
+ *  around the level does not trigger. Once the pre-trigger part is filled,
+ *  a trigger starts the post-trigger count; when it runs out, the buffer
+ *  is frozen and holds the pre-trigger samples, the trigger sample and the
+ *  samples after it.
+ *
+ *  The capture is fed with the unfiltered samples: the default median and
+ *  average of the filter chain would remove a spike of one sample and
+ *  spread a step over several samples.
+ *
+ *  capture_sample runs in the ADC ISR (a few dozen cycles). Arming switches
+ *  the ADC to the capture rate, which is restored when the capture is done
+ *  or stopped.
+ */
+
+#ifndef _CAPTURE_H
+#define _CAPTURE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//! Samples of a capture (power of 2, at most 256)
+#define CAPTURE_SIZE 256
+
+//! Default sample period of a capture in microseconds (5kHz)
+#define CAPTURE_PERIOD_US 200
+
+//! Not armed, the buffer is empty
+#define CAPTURE_IDLE 0
+
+//! Filling the pre-trigger part or waiting for the trigger
+#define CAPTURE_ARMED 1
+
+//! Triggered, filling the post-trigger part
+#define CAPTURE_TRIGGERED 2
+
+//! The buffer is frozen
+#define CAPTURE_DONE 3
+
+//! Trigger on a rising edge
+#define CAPTURE_RISING 0
+
+//! Trigger on a falling edge
+#define CAPTURE_FALLING 1
+
+//! Settings of a capture
+typedef struct {
+    uint16_t level;      //!< Trigger level (0...1023)
+    uint16_t hysteresis; //!< Distance from the level that re-enables the trigger
+    uint8_t edge;        //!< CAPTURE_RISING or CAPTURE_FALLING
+    uint8_t preTrigger;  //!< Samples kept before the trigger (< CAPTURE_SIZE)
+    uint16_t periodUs;   //!< Microseconds between two samples
+} CaptureConfig;
+
+//! Stops a running capture and sets the default settings
+void capture_init(void);
+
+//! Returns the settings, changes take effect with the next capture_arm
+CaptureConfig *capture_config(void);
+
+//! Clears the buffer and starts waiting for the trigger
+void capture_arm(void);
+
+//! Stops a running capture (a frozen buffer stays valid)
+void capture_stop(void);
+
+//! Returns CAPTURE_IDLE, CAPTURE_ARMED, CAPTURE_TRIGGERED or CAPTURE_DONE
+uint8_t capture_state(void);
+
+//! Returns a sample of the frozen buffer, 0 is the oldest
+uint16_t capture_get(uint8_t index);
+
+//! Returns the index of the trigger sample in the frozen buffer
+uint8_t capture_triggerIndex(void);
+
+//! Returns the time of a sample of the frozen buffer relative to the trigger in microseconds
+int32_t capture_time(uint8_t index);
+
+//! Feeds a sample, called by the ADC ISR
+void capture_sample(uint16_t sample);
+
+#endif
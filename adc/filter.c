@@ -0,0 +1,279 @@
+#include "filter.h"
+
+#include <stddef.h>
+#include <string.h>
+
+/*! \file
+ *  Constant time Q15 filter stages.
+ */
+
+//! Compare-and-swap of a sorting network
+#define FILTER_SORT(a, b) do { if ((a) > (b)) { int16_t const t = (a); (a) = (b); (b) = t; } } while (0)
+
+/*!
+ *  Limits a Q15 result to the range of int16_t.
+ */
+static int16_t filter_saturate(int32_t value) {
+    if (value > INT16_MAX) {
+        return INT16_MAX;
+    }
+    if (value < INT16_MIN) {
+        return INT16_MIN;
+    }
+    return value;
+}
+
+/*!
+ *  Reserves the next stage of a chain.
+ *
+ *  \param chain  The chain.
+ *  \param type   FILTER_* of the stage.
+ *  \return       The cleared stage or NULL if the chain is full.
+ */
+static FilterStage *filter_append(FilterChain *chain, uint8_t type) {
+    FilterStage *stage;
+
+    if (chain->count == FILTER_STAGES) {
+        return NULL;
+    }
+
+    stage = &chain->stages[chain->count];
+    memset(stage, 0, sizeof(*stage));
+    stage->type = type;
+    return stage;
+}
+
+/*!
+ *  Removes all stages of a chain.
+ *
+ *  \param chain  The chain.
+ */
+void filter_clear(FilterChain *chain) {
+    chain->count = 0;
+}
+
+/*!
+ *  Appends a moving average over 2^shift samples. It keeps a running sum,
+ *  so its cost does not depend on the window.
+ *
+ *  \param chain  The chain.
+ *  \param shift  1...FILTER_BOXCAR_MAX_SHIFT.
+ *  \return       False if the stage could not be added.
+ */
+bool filter_addBoxcar(FilterChain *chain, uint8_t shift) {
+    FilterStage *stage;
+
+    if (shift < 1 || shift > FILTER_BOXCAR_MAX_SHIFT || !(stage = filter_append(chain, FILTER_BOXCAR))) {
+        return false;
+    }
+    stage->size = shift;
+    chain->count++;
+    return true;
+}
+
+/*!
+ *  Appends a first-order low pass y += alpha * (x - y). The time constant
+ *  is about 1 / alpha samples.
+ *
+ *  \param chain  The chain.
+ *  \param alpha  Weight of a new sample (Q15, 1...32767).
+ *  \return       False if the stage could not be added.
+ */
+bool filter_addIir1(FilterChain *chain, int16_t alpha) {
+    FilterStage *stage;
+
+    if (alpha <= 0 || !(stage = filter_append(chain, FILTER_IIR1))) {
+        return false;
+    }
+    stage->u.iir1.alpha = alpha;
+    chain->count++;
+    return true;
+}
+
+/*!
+ *  Appends a biquad (second-order IIR).
+ *
+ *  \param chain         The chain.
+ *  \param coefficients  Coefficients in Q14 (copied).
+ *  \return              False if the stage could not be added.
+ */
+bool filter_addIir2(FilterChain *chain, FilterBiquad const *coefficients) {
+    FilterStage *stage;
+
+    if (!(stage = filter_append(chain, FILTER_IIR2))) {
+        return false;
+    }
+    stage->u.iir2.c = *coefficients;
+    chain->count++;
+    return true;
+}
+
+/*!
+ *  Appends a FIR. The sum of the magnitudes of the coefficients must not
+ *  exceed 1.0, otherwise the accumulator could overflow.
+ *
+ *  \param chain         The chain.
+ *  \param coefficients  Coefficients in Q15 (copied), the first one is
+ *                       applied to the newest sample.
+ *  \param taps          Number of coefficients (1...FILTER_FIR_TAPS).
+ *  \return              False if the stage could not be added.
+ */
+bool filter_addFir(FilterChain *chain, int16_t const *coefficients, uint8_t taps) {
+    FilterStage *stage;
+
+    if (taps < 1 || taps > FILTER_FIR_TAPS || !(stage = filter_append(chain, FILTER_FIR))) {
+        return false;
+    }
+    stage->size = taps;
+    memcpy(stage->u.fir.coefficients, coefficients, taps * sizeof(int16_t));
+    chain->count++;
+    return true;
+}
+
+/*!
+ *  Appends a median filter, which removes single spikes without blurring
+ *  edges.
+ *
+ *  \param chain  The chain.
+ *  \param taps   3 or 5.
+ *  \return       False if the stage could not be added.
+ */
+bool filter_addMedian(FilterChain *chain, uint8_t taps) {
+    FilterStage *stage;
+
+    if ((taps != 3 && taps != 5) || !(stage = filter_append(chain, FILTER_MEDIAN))) {
+        return false;
+    }
+    stage->size = taps;
+    chain->count++;
+    return true;
+}
+
+/*!
+ *  Moving average over 2^shift samples with a running sum.
+ */
+static int16_t filter_boxcar(FilterStage *stage, int16_t x) {
+    uint8_t const index = stage->index;
+
+    stage->u.boxcar.sum += x - stage->u.boxcar.history[index];
+    stage->u.boxcar.history[index] = x;
+    stage->index = (index + 1) & ((1 << stage->size) - 1);
+
+    return stage->u.boxcar.sum >> stage->size;
+}
+
+/*!
+ *  First-order low pass. The state keeps 8 more bits than the samples, so
+ *  small values of alpha still converge.
+ */
+static int16_t filter_iir1(FilterStage *stage, int16_t x) {
+    int32_t const diff = (int32_t)x - (stage->u.iir1.y >> 8);
+
+    stage->u.iir1.y += (diff * stage->u.iir1.alpha) >> 7;
+    return stage->u.iir1.y >> 8;
+}
+
+/*!
+ *  Biquad in direct form I. The Q29 products are reduced by 2 bits before
+ *  they are summed, so five of them cannot overflow the accumulator.
+ */
+static int16_t filter_iir2(FilterStage *stage, int16_t x) {
+    FilterBiquad const *const c = &stage->u.iir2.c;
+    int32_t accumulator;
+    int16_t y;
+
+    accumulator  = ((int32_t)c->b0 * x) >> 2;
+    accumulator += ((int32_t)c->b1 * stage->u.iir2.x1) >> 2;
+    accumulator += ((int32_t)c->b2 * stage->u.iir2.x2) >> 2;
+    accumulator -= ((int32_t)c->a1 * stage->u.iir2.y1) >> 2;
+    accumulator -= ((int32_t)c->a2 * stage->u.iir2.y2) >> 2;
+    y = filter_saturate(accumulator >> 12);
+
+    stage->u.iir2.x2 = stage->u.iir2.x1;
+    stage->u.iir2.x1 = x;
+    stage->u.iir2.y2 = stage->u.iir2.y1;
+    stage->u.iir2.y1 = y;
+    return y;
+}
+
+/*!
+ *  FIR over a circular delay line.
+ */
+static int16_t filter_fir(FilterStage *stage, int16_t x) {
+    uint8_t const taps = stage->size;
+    uint8_t index = stage->index;
+    int32_t accumulator = 0;
+    uint8_t i;
+
+    stage->u.fir.history[index] = x;
+    stage->index = (index + 1 == taps) ? 0 : index + 1;
+
+    // Coefficient 0 belongs to the newest sample, going back in time
+    for (i = 0; i < taps; i++) {
+        accumulator += (int32_t)stage->u.fir.coefficients[i] * stage->u.fir.history[index];
+        index = index ? index - 1 : taps - 1;
+    }
+    return filter_saturate(accumulator >> 15);
+}
+
+/*!
+ *  Median of the last 3 or 5 samples with a sorting network.
+ */
+static int16_t filter_median(FilterStage *stage, int16_t x) {
+    int16_t *const history = stage->u.median.history;
+    uint8_t const index = stage->index;
+
+    history[index] = x;
+    stage->index = (index + 1 == stage->size) ? 0 : index + 1;
+
+    if (stage->size == 3) {
+        int16_t a = history[0], b = history[1], c = history[2];
+        FILTER_SORT(a, b);
+        FILTER_SORT(b, c);
+        FILTER_SORT(a, b);
+        return b;
+    } else {
+        int16_t v0 = history[0], v1 = history[1], v2 = history[2], v3 = history[3], v4 = history[4];
+        FILTER_SORT(v0, v1);
+        FILTER_SORT(v3, v4);
+        FILTER_SORT(v0, v3);
+        FILTER_SORT(v1, v4);
+        FILTER_SORT(v1, v2);
+        FILTER_SORT(v2, v3);
+        FILTER_SORT(v1, v2);
+        return v2;
+    }
+}
+
+/*!
+ *  Runs a sample through all stages of a chain.
+ *
+ *  \param chain   The chain.
+ *  \param sample  Q15 sample.
+ *  \return        The filtered Q15 sample.
+ */
+int16_t filter_run(FilterChain *chain, int16_t sample) {
+    FilterStage *stage = chain->stages;
+    uint8_t i;
+
+    for (i = chain->count; i; i--, stage++) {
+        switch (stage->type) {
+            case FILTER_BOXCAR:
+                sample = filter_boxcar(stage, sample);
+                break;
+            case FILTER_IIR1:
+                sample = filter_iir1(stage, sample);
+                break;
+            case FILTER_IIR2:
+                sample = filter_iir2(stage, sample);
+                break;
+            case FILTER_FIR:
+                sample = filter_fir(stage, sample);
+                break;
+            case FILTER_MEDIAN:
+                sample = filter_median(stage, sample);
+                break;
+        }
+    }
+    return sample;
+}
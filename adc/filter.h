@@ -0,0 +1,118 @@
+/*! \file
+ *  \brief Fixed-point filter chain for a sample stream.
+ *
+ *  A chain runs up to FILTER_STAGES stages one after the other on every
+ *  sample. Samples are signed Q15 values (the ADC converts its 10 bit
+ *  results with << 5). Every stage takes constant time and no division,
+ *  so the whole chain can run in the ADC ISR.
+ *
+ *  Cycles per sample (estimated from the C code for avr-gcc -O2 with the
+ *  hardware multiplier, including the dispatch; to be confirmed with
+ *  latencyMaxIsr on the target):
+ *    - FILTER_BOXCAR (running sum over 2^n samples):   ~50
+ *    - FILTER_IIR1 (first-order low pass):              ~60
+ *    - FILTER_IIR2 (biquad, direct form I):            ~200
+ *    - FILTER_FIR (n taps):                            ~40 + 30 per tap
+ *    - FILTER_MEDIAN (3 taps / 5 taps):                ~60 / ~180
+ *  At the highest ADC rate (about 11.1kHz, 1800 cycles per sample) the ISR
+ *  itself needs about 150 cycles, so a chain should stay below roughly
+ *  1000 cycles to leave time for the rest of the program; at 1kHz the
+ *  budget is ten times larger.
+ */
+
+#ifndef _FILTER_H
+#define _FILTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//! Maximum number of stages of a chain
+#define FILTER_STAGES 4
+
+//! Maximum number of taps of a FIR stage
+#define FILTER_FIR_TAPS 8
+
+//! Maximum window of a boxcar stage (2^FILTER_BOXCAR_MAX_SHIFT samples)
+#define FILTER_BOXCAR_MAX_SHIFT 4
+
+//! Running sum over the last 2^shift samples
+#define FILTER_BOXCAR 1
+
+//! y += a * (x - y)
+#define FILTER_IIR1 2
+
+//! Biquad with Q14 coefficients
+#define FILTER_IIR2 3
+
+//! Finite impulse response with Q15 coefficients
+#define FILTER_FIR 4
+
+//! Median of the last 3 or 5 samples
+#define FILTER_MEDIAN 5
+
+//! Coefficients of a biquad (Q14, i.e. 16384 = 1.0):
+//! y = b0 x[n] + b1 x[n-1] + b2 x[n-2] - a1 y[n-1] - a2 y[n-2]
+typedef struct {
+    int16_t b0, b1, b2, a1, a2;
+} FilterBiquad;
+
+//! A stage of a chain
+typedef struct {
+    uint8_t type;  //!< FILTER_*
+    uint8_t size;  //!< Boxcar: shift, FIR: taps, median: taps
+    uint8_t index; //!< Position in the delay line
+    union {
+        struct {
+            int32_t sum;
+            int16_t history[1 << FILTER_BOXCAR_MAX_SHIFT];
+        } boxcar;
+        struct {
+            int16_t alpha; //!< Q15
+            int32_t y;     //!< Q15 << 8 (more resolution for small alpha)
+        } iir1;
+        struct {
+            FilterBiquad c;
+            int16_t x1, x2, y1, y2;
+        } iir2;
+        struct {
+            int16_t coefficients[FILTER_FIR_TAPS]; //!< Q15
+            int16_t history[FILTER_FIR_TAPS];
+        } fir;
+        struct {
+            int16_t history[5];
+        } median;
+    } u;
+} FilterStage;
+
+//! A chain of stages
+typedef struct {
+    uint8_t count;                      //!< Stages in use
+    FilterStage stages[FILTER_STAGES];  //!< The stages in order
+} FilterChain;
+
+// The functions that add a stage return false if the chain is full or the
+// parameters are invalid. A chain that is used by an ISR has to be changed
+// with interrupts disabled.
+
+//! Removes all stages (the chain passes the samples through)
+void filter_clear(FilterChain *chain);
+
+//! Appends a boxcar over 2^shift samples (shift 1...FILTER_BOXCAR_MAX_SHIFT)
+bool filter_addBoxcar(FilterChain *chain, uint8_t shift);
+
+//! Appends a first-order low pass with y += alpha * (x - y) (alpha in Q15)
+bool filter_addIir1(FilterChain *chain, int16_t alpha);
+
+//! Appends a biquad
+bool filter_addIir2(FilterChain *chain, FilterBiquad const *coefficients);
+
+//! Appends a FIR with up to FILTER_FIR_TAPS Q15 coefficients (sum of their magnitudes <= 1.0)
+bool filter_addFir(FilterChain *chain, int16_t const *coefficients, uint8_t taps);
+
+//! Appends a median over 3 or 5 samples
+bool filter_addMedian(FilterChain *chain, uint8_t taps);
+
+//! Runs a Q15 sample through all stages and returns the result
+int16_t filter_run(FilterChain *chain, int16_t sample);
+
+#endif
@@ -0,0 +1,312 @@
+#include "fmt.h"
+
+#include <avr/pgmspace.h>
+
+/*! \file
+ *  Compact formatted output without the avr-libc vfprintf.
+ */
+
+//! Powers of ten used for the division-free decimal conversion
+static const uint32_t fmt_pow10[FMT_MAX_DIGITS] PROGMEM = {
+    1000000000UL, 100000000UL, 10000000UL, 1000000UL, 100000UL,
+    10000UL, 1000UL, 100UL, 10UL, 1UL
+};
+
+/*!
+ *  Converts an unsigned number into its decimal digits by repeated
+ *  subtraction. The AVR core has no divider, so this is considerably faster
+ *  than dividing by 10 for every digit. Numbers that fit into 16 bits skip the
+ *  five upper powers of ten.
+ *
+ *  \param value   The number to be converted.
+ *  \param digits  Buffer for at least FMT_MAX_DIGITS characters (not terminated).
+ *  \return        The number of digits written (at least one).
+ */
+static uint8_t fmt_toDecimal(uint32_t value, char *digits) {
+    uint8_t len = 0;
+    uint8_t i = (value > 0xFFFF) ? 0 : 5;
+
+    for (; i < FMT_MAX_DIGITS; i++) {
+        uint32_t const pow = pgm_read_dword(&fmt_pow10[i]);
+        char digit = '0';
+        while (value >= pow) {
+            value -= pow;
+            digit++;
+        }
+        // Skip leading zeros but always keep the last digit
+        if (len || digit != '0' || i == FMT_MAX_DIGITS - 1) {
+            digits[len++] = digit;
+        }
+    }
+    return len;
+}
+
+/*!
+ *  Writes count pad characters.
+ */
+static void fmt_pad(fmt_sink_t sink, void *context, char pad, uint8_t count) {
+    while (count--) {
+        sink(pad, context);
+    }
+}
+
+/*!
+ *  Writes a decimal number with optional sign, decimal point and padding.
+ *  This is the common back end of all decimal conversions.
+ *
+ *  \param magnitude  Absolute value of the number.
+ *  \param negative   Whether a '-' shall be written in front of the number.
+ *  \param decimals   Number of digits behind the decimal point (0 = integer).
+ *  \param width      Minimum number of characters to be written.
+ *  \param pad        Character used for padding (' ' or '0').
+ *  \return           The number of characters written.
+ */
+static uint8_t fmt_decimal(fmt_sink_t sink, void *context, uint32_t magnitude, bool negative, uint8_t decimals, uint8_t width, char pad) {
+    char digits[FMT_MAX_DIGITS];
+    uint8_t const len = fmt_toDecimal(magnitude, digits);
+
+    // A fixed-point number needs at least one digit in front of the point
+    uint8_t count = (len > decimals) ? len : decimals + 1;
+    uint8_t const total = count + (decimals ? 1 : 0) + (negative ? 1 : 0);
+
+    if (pad != '0' && width > total) {
+        fmt_pad(sink, context, pad, width - total);
+    }
+    if (negative) {
+        sink('-', context);
+    }
+    if (pad == '0' && width > total) {
+        fmt_pad(sink, context, '0', width - total);
+    }
+
+    // count is the number of digits still to be written
+    while (count--) {
+        if (decimals && count + 1 == decimals) {
+            sink('.', context);
+        }
+        sink(count < len ? digits[len - 1 - count] : '0', context);
+    }
+
+    return (width > total) ? width : total;
+}
+
+/*!
+ *  Writes an unsigned decimal number.
+ *
+ *  \param value  The number to be written.
+ *  \param width  Minimum number of characters to be written.
+ *  \param pad    Character used for padding (' ' or '0').
+ *  \return       The number of characters written.
+ */
+uint8_t fmt_unsigned(fmt_sink_t sink, void *context, uint32_t value, uint8_t width, char pad) {
+    return fmt_decimal(sink, context, value, false, 0, width, pad);
+}
+
+/*!
+ *  Writes a signed decimal number.
+ *
+ *  \param value  The number to be written.
+ *  \param width  Minimum number of characters to be written.
+ *  \param pad    Character used for padding (' ' or '0').
+ *  \return       The number of characters written.
+ */
+uint8_t fmt_signed(fmt_sink_t sink, void *context, int32_t value, uint8_t width, char pad) {
+    return fmt_fixed(sink, context, value, 0, width, pad);
+}
+
+/*!
+ *  Writes a fixed-point number, i.e. an integer that holds the value scaled
+ *  by 10^decimals. For example 4987 with 3 decimals is written as "4.987".
+ *
+ *  \param value     The scaled number to be written.
+ *  \param decimals  Number of digits behind the decimal point.
+ *  \param width     Minimum number of characters to be written.
+ *  \param pad       Character used for padding (' ' or '0').
+ *  \return          The number of characters written.
+ */
+uint8_t fmt_fixed(fmt_sink_t sink, void *context, int32_t value, uint8_t decimals, uint8_t width, char pad) {
+    bool const negative = value < 0;
+    uint32_t const magnitude = negative ? -(uint32_t)value : (uint32_t)value;
+
+    return fmt_decimal(sink, context, magnitude, negative, decimals, width, pad);
+}
+
+/*!
+ *  Writes a hexadecimal number without prefix.
+ *
+ *  \param value  The number to be written.
+ *  \param width  Minimum number of characters to be written.
+ *  \param pad    Character used for padding (' ' or '0').
+ *  \param upper  Use upper case letters.
+ *  \return       The number of characters written.
+ */
+uint8_t fmt_hex(fmt_sink_t sink, void *context, uint32_t value, uint8_t width, char pad, bool upper) {
+    // Count the significant nibbles (at least one)
+    uint8_t len = 1;
+    while (len < 8 && (value >> (4 * len))) {
+        len++;
+    }
+
+    if (width > len) {
+        fmt_pad(sink, context, pad, width - len);
+    }
+
+    uint8_t nib = len;
+    while (nib--) {
+        uint8_t const digit = (value >> (4 * nib)) & 0xF;
+        if (digit < 10) {
+            sink('0' + digit, context);
+        } else {
+            sink((upper ? 'A' : 'a') + digit - 10, context);
+        }
+    }
+
+    return (width > len) ? width : len;
+}
+
+/*!
+ *  Writes a format string from the program flash memory. See fmt.h for the
+ *  supported conversions. Unknown conversions are written verbatim.
+ *
+ *  \param sink     Receives the formatted characters.
+ *  \param context  Passed to the sink unchanged.
+ *  \param format   Format string in the program flash memory.
+ *  \param args     Arguments of the conversions.
+ *  \return         The number of characters written.
+ */
+uint16_t fmt_vformat_P(fmt_sink_t sink, void *context, const char *format, va_list args) {
+    uint16_t written = 0;
+    char c;
+
+    while ((c = pgm_read_byte(format++))) {
+        if (c != '%') {
+            sink(c, context);
+            written++;
+            continue;
+        }
+
+        // Flags, width, decimals and length modifier
+        char pad = ' ';
+        uint8_t width = 0;
+        uint8_t decimals = 0;
+        bool isLong = false;
+
+        c = pgm_read_byte(format++);
+        if (c == '0') {
+            pad = '0';
+            c = pgm_read_byte(format++);
+        }
+        while (c >= '0' && c <= '9') {
+            width = width * 10 + (c - '0');
+            c = pgm_read_byte(format++);
+        }
+        if (c == '.') {
+            c = pgm_read_byte(format++);
+            while (c >= '0' && c <= '9') {
+                decimals = decimals * 10 + (c - '0');
+                c = pgm_read_byte(format++);
+            }
+        }
+        if (c == 'l') {
+            isLong = true;
+            c = pgm_read_byte(format++);
+        }
+
+        switch (c) {
+            case 'c':
+                sink((char)va_arg(args, int), context);
+                written++;
+                break;
+            case 's': {
+                char const *s = va_arg(args, char const *);
+                while (*s) {
+                    sink(*s++, context);
+                    written++;
+                }
+                break;
+            }
+            case 'S': {
+                char const *s = va_arg(args, char const *);
+                char sc;
+                while ((sc = pgm_read_byte(s++))) {
+                    sink(sc, context);
+                    written++;
+                }
+                break;
+            }
+            case 'd':
+            case 'k': {
+                int32_t const value = isLong ? va_arg(args, long) : va_arg(args, int);
+                written += fmt_fixed(sink, context, value, (c == 'k') ? decimals : 0, width, pad);
+                break;
+            }
+            case 'u': {
+                uint32_t const value = isLong ? va_arg(args, unsigned long) : va_arg(args, unsigned int);
+                written += fmt_unsigned(sink, context, value, width, pad);
+                break;
+            }
+            case 'x':
+            case 'X': {
+                uint32_t const value = isLong ? va_arg(args, unsigned long) : va_arg(args, unsigned int);
+                written += fmt_hex(sink, context, value, width, pad, c == 'X');
+                break;
+            }
+            case '\0':
+                // Format string ends within a conversion
+                return written;
+            default:
+                // '%%' and unknown conversions
+                sink(c, context);
+                written++;
+                break;
+        }
+    }
+
+    return written;
+}
+
+/*!
+ *  Writes a format string from the program flash memory.
+ *  See fmt_vformat_P for details.
+ */
+uint16_t fmt_format_P(fmt_sink_t sink, void *context, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    uint16_t const written = fmt_vformat_P(sink, context, format, args);
+    va_end(args);
+    return written;
+}
+
+#if FMT_STDIO_SHIM
+/*!
+ *  Sink that forwards characters to a stdio stream.
+ *  \internal
+ */
+static void fmt_streamSink(char c, void *context) {
+    fputc(c, (FILE *)context);
+}
+
+/*!
+ *  Drop-in replacement for vfprintf_P that uses the compact formatter.
+ *  Only the conversions listed in fmt.h are supported.
+ *
+ *  \param stream  The stream to write to (e.g. lcdout or stderr).
+ *  \param format  Format string in the program flash memory.
+ *  \param args    Arguments of the conversions.
+ *  \return        The number of characters written.
+ */
+int fmt_vfprintf_P(FILE *stream, const char *format, va_list args) {
+    return fmt_vformat_P(fmt_streamSink, stream, format, args);
+}
+
+/*!
+ *  Drop-in replacement for fprintf_P. See fmt_vfprintf_P for details.
+ */
+int fmt_fprintf_P(FILE *stream, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int const written = fmt_vfprintf_P(stream, format, args);
+    va_end(args);
+    return written;
+}
+#endif
@@ -0,0 +1,67 @@
+/*! \file
+ *  \brief Compact formatted output.
+ *
+ *  Small, type-specialized replacement for the avr-libc printf family. Only
+ *  the conversions used in this project are supported, format strings are
+ *  always read from the program flash memory and fixed-point values take the
+ *  place of floats, so neither vfprintf nor printf_flt has to be linked.
+ *
+ *  Format: %[0][width][.decimals][l]conversion
+ *  - c   character
+ *  - s   string in SRAM
+ *  - S   string in the program flash memory
+ *  - d   signed decimal
+ *  - u   unsigned decimal
+ *  - x/X hexadecimal (lower/upper case letters)
+ *  - k   signed fixed-point number scaled by 10^decimals,
+ *        e.g. ("%.3k", 4987) prints "4.987"
+ *  - %   a literal '%'
+ *
+ *  Width and zero padding apply to numbers only. Without 'l' the argument is
+ *  an int (16 bit), with 'l' it is a long (32 bit).
+ */
+
+#ifndef _FMT_H
+#define _FMT_H
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+//! Set to 0 to drop the vfprintf compatible FILE* interface
+#define FMT_STDIO_SHIM 1
+
+//! Maximum number of decimal digits of a 32 bit number
+#define FMT_MAX_DIGITS 10
+
+//! Receives the formatted characters one by one
+typedef void (*fmt_sink_t)(char c, void *context);
+
+//! Writes an unsigned decimal number padded to width characters
+uint8_t fmt_unsigned(fmt_sink_t sink, void *context, uint32_t value, uint8_t width, char pad);
+
+//! Writes a signed decimal number padded to width characters
+uint8_t fmt_signed(fmt_sink_t sink, void *context, int32_t value, uint8_t width, char pad);
+
+//! Writes a fixed-point number scaled by 10^decimals padded to width characters
+uint8_t fmt_fixed(fmt_sink_t sink, void *context, int32_t value, uint8_t decimals, uint8_t width, char pad);
+
+//! Writes a hexadecimal number padded to width characters
+uint8_t fmt_hex(fmt_sink_t sink, void *context, uint32_t value, uint8_t width, char pad, bool upper);
+
+//! Writes the PROGMEM format string with its arguments to the sink
+uint16_t fmt_vformat_P(fmt_sink_t sink, void *context, const char *format, va_list args);
+
+//! Writes the PROGMEM format string with its arguments to the sink
+uint16_t fmt_format_P(fmt_sink_t sink, void *context, const char *format, ...);
+
+#if FMT_STDIO_SHIM
+//! vfprintf_P compatible output to a stdio stream (e.g. lcdout)
+int fmt_vfprintf_P(FILE *stream, const char *format, va_list args);
+
+//! fprintf_P compatible output to a stdio stream (e.g. lcdout)
+int fmt_fprintf_P(FILE *stream, const char *format, ...);
+#endif
+
+#endif
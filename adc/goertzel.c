@@ -0,0 +1,246 @@
+#include "goertzel.h"
+#include "adc.h"
+
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
+
+/*! \file
+ *  Goertzel resonators in fixed point.
+ */
+
+//! A bin
+typedef struct {
+    uint16_t k;  //!< Index of the frequency (k * fs / N), 0 if disabled
+    int16_t c;   //!< 2 cos(2 pi k / N) in Q14
+    int32_t s1;  //!< s[n-1]
+    int32_t s2;  //!< s[n-2]
+} GoertzelBin;
+
+//! State of a bin at the end of the last block
+typedef struct {
+    int32_t s1;
+    int32_t s2;
+} GoertzelResult;
+
+//! cos(i * pi / 128) in Q14 for i = 0...64 (a quarter of the period)
+static const int16_t goertzelCos[65] PROGMEM = {
+    16384, 16379, 16364, 16340, 16305, 16261, 16207, 16143,
+    16069, 15986, 15893, 15791, 15679, 15557, 15426, 15286,
+    15137, 14978, 14811, 14635, 14449, 14256, 14053, 13842,
+    13623, 13395, 13160, 12916, 12665, 12406, 12140, 11866,
+    11585, 11297, 11003, 10702, 10394, 10080,  9760,  9434,
+     9102,  8765,  8423,  8076,  7723,  7366,  7005,  6639,
+     6270,  5897,  5520,  5139,  4756,  4370,  3981,  3590,
+     3196,  2801,  2404,  2006,  1606,  1205,   804,   402,
+        0,
+};
+
+//! The bins, changed by the ISR
+static GoertzelBin goertzelBins[GOERTZEL_BINS];
+
+//! States of the last complete block
+static GoertzelResult goertzelResults[GOERTZEL_BINS];
+
+//! Samples per block
+static uint16_t goertzelBlock = GOERTZEL_BLOCK;
+
+//! Samples of the running block
+static uint16_t goertzelCount;
+
+//! Completed blocks
+static volatile uint8_t goertzelBlockCount;
+
+/*!
+ *  Cosine of a phase, interpolated from the quarter table.
+ *
+ *  \param phase  Angle, 65536 is a full period.
+ *  \return       The cosine in Q14.
+ */
+static int16_t goertzel_cos(uint16_t phase) {
+    uint8_t const quadrant = phase >> 14;
+    uint16_t x = phase & 0x3FFF;
+    uint8_t index;
+    int16_t value;
+
+    // Quadrants 1 and 3 run backwards through the table, 1 and 2 are negative
+    if (quadrant & 1) {
+        x = 0x4000 - x;
+    }
+    index = x >> 8;
+    value = pgm_read_word(&goertzelCos[index]);
+    if (index < 64) {
+        int16_t const next = pgm_read_word(&goertzelCos[index + 1]);
+        value += ((int32_t)(next - value) * (x & 0xFF)) >> 8;
+    }
+    return (quadrant == 1 || quadrant == 2) ? -value : value;
+}
+
+/*!
+ *  Sets the block size and disables all bins.
+ *
+ *  \param block  Samples per block (N), limited to GOERTZEL_MAX_BLOCK.
+ */
+void goertzel_init(uint16_t block) {
+    uint8_t i;
+
+    if (block > GOERTZEL_MAX_BLOCK) {
+        block = GOERTZEL_MAX_BLOCK;
+    }
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        goertzelBlock = block;
+        goertzelCount = 0;
+        for (i = 0; i < GOERTZEL_BINS; i++) {
+            goertzelBins[i].k = 0;
+            goertzelResults[i].s1 = goertzelResults[i].s2 = 0;
+        }
+    }
+}
+
+/*!
+ *  Sets the frequency of a bin. It is rounded to the nearest multiple of
+ *  fs / N at the current sample rate of the ADC.
+ *
+ *  \param bin  Index of the bin.
+ *  \param hz   Frequency, 0 to disable the bin.
+ *  \return     False if the bin does not exist or the frequency is not
+ *              between fs / N and below fs / 2.
+ */
+bool goertzel_setBin(uint8_t bin, uint16_t hz) {
+    uint32_t cycles;
+    uint16_t k;
+    int16_t c;
+
+    if (bin >= GOERTZEL_BINS) {
+        return false;
+    }
+
+    // Frequencies from fs / 2 on (hz * period >= 10^6 / 2) are rejected
+    // first, so hz * period * N below cannot overflow
+    cycles = (uint32_t)hz * getAdcSamplePeriod();
+    if (cycles >= 500000UL) {
+        return false;
+    }
+
+    // k = hz * N / fs = hz * N * period / 10^6
+    k = (cycles * goertzelBlock + 500000UL) / 1000000UL;
+    if (hz && (k == 0 || 2 * k >= goertzelBlock)) {
+        return false;
+    }
+
+    // 2 cos in Q14, the largest values (k = 1 with a big block) are limited
+    c = goertzel_cos(((uint32_t)k << 16) / goertzelBlock);
+    c = (c >= 16384) ? 32767 : 2 * c;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        goertzelBins[bin].k = k;
+        goertzelBins[bin].c = c;
+        goertzelBins[bin].s1 = goertzelBins[bin].s2 = 0;
+        goertzelResults[bin].s1 = goertzelResults[bin].s2 = 0;
+    }
+    return true;
+}
+
+/*!
+ *  \param bin  Index of the bin.
+ *  \return     The frequency of the bin in Hz (k * fs / N), 0 if disabled.
+ */
+uint16_t goertzel_binFrequency(uint8_t bin) {
+    if (bin >= GOERTZEL_BINS) {
+        return 0;
+    }
+    return (goertzelBins[bin].k * 1000000UL + (uint32_t)goertzelBlock * getAdcSamplePeriod() / 2) / ((uint32_t)goertzelBlock * getAdcSamplePeriod());
+}
+
+/*!
+ *  Computes the amplitude of a bin from the last complete block:
+ *  |X|^2 = s1^2 + s2^2 - c s1 s2, amplitude = 2 |X| / N.
+ *
+ *  \param bin  Index of the bin.
+ *  \return     Amplitude of the sine in ADC counts.
+ */
+uint16_t goertzel_amplitude(uint8_t bin) {
+    GoertzelResult result;
+    int64_t power;
+    uint32_t reduced, root, bit;
+    uint8_t shift = 0;
+
+    if (bin >= GOERTZEL_BINS || !goertzelBins[bin].k) {
+        return 0;
+    }
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        result = goertzelResults[bin];
+    }
+
+    power = (int64_t)result.s1 * result.s1 + (int64_t)result.s2 * result.s2
+          - (((int64_t)goertzelBins[bin].c * result.s1 >> 14) * result.s2);
+    if (power <= 0) {
+        return 0;
+    }
+
+    // Integer square root in 32 bit, the power is reduced by a factor of 4
+    // per bit of the root that is dropped
+    while (power >> 32) {
+        power >>= 2;
+        shift++;
+    }
+    reduced = power;
+    root = 0;
+    for (bit = 1UL << 30; bit; bit >>= 2) {
+        if (reduced >= root + bit) {
+            reduced -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+    }
+
+    return ((root << shift) * 2 + goertzelBlock / 2) / goertzelBlock;
+}
+
+/*!
+ *  \return The number of completed blocks, to see whether there are new
+ *          results.
+ */
+uint8_t goertzel_blocks(void) {
+    return goertzelBlockCount;
+}
+
+/*!
+ *  Runs the resonators of all bins for a sample. Runs in the ADC ISR.
+ *
+ *  \param sample  The sample (0...1023).
+ */
+void goertzel_sample(uint16_t sample) {
+    int16_t const x = sample - 512;
+    bool const last = (++goertzelCount == goertzelBlock);
+    GoertzelBin *bin = goertzelBins;
+    uint8_t i;
+
+    for (i = 0; i < GOERTZEL_BINS; i++, bin++) {
+        int32_t const s1 = bin->s1;
+        int32_t product;
+
+        if (!bin->k) {
+            continue;
+        }
+
+        // c * s1 >> 14 with two 16 x 16 bit products: |s1| stays below 2^29
+        // with blocks up to GOERTZEL_MAX_BLOCK
+        product = ((int32_t)bin->c * (int16_t)(s1 >> 16)) << 2;
+        product += ((int32_t)bin->c * (uint16_t)s1) >> 14;
+
+        bin->s1 = x + product - bin->s2;
+        bin->s2 = s1;
+
+        if (last) {
+            goertzelResults[i].s1 = bin->s1;
+            goertzelResults[i].s2 = bin->s2;
+            bin->s1 = bin->s2 = 0;
+        }
+    }
+
+    if (last) {
+        goertzelCount = 0;
+        goertzelBlockCount++;
+    }
+}
@@ -0,0 +1,63 @@
+/*! \file
+ *  \brief Tone detection with the Goertzel algorithm.
+ *
+ *  Measures the amplitude of up to GOERTZEL_BINS frequencies in the ADC
+ *  samples. Every sample updates the resonator of each bin
+ *      s[n] = x[n] + c * s[n-1] - s[n-2]   with c = 2 cos(2 pi k / N)
+ *  in fixed point (c in Q14, the state in 32 bit), so nothing has to be
+ *  stored. After a block of N samples the state of every bin is handed over
+ *  and the resonators start again; the amplitude is computed from it when
+ *  it is read, outside the ISR.
+ *
+ *  A bin measures the frequency k * fs / N with an integer k. As the ADC is
+ *  triggered by a timer, fs is exact and so are the bin frequencies; a
+ *  frequency in between is rounded to the nearest bin (resolution fs / N,
+ *  e.g. 5Hz at 1kHz with the default block). DC (the half of the range
+ *  subtracted from the samples) falls into bin 0 and does not leak into
+ *  the others.
+ *
+ *  Cycles per sample (estimated from the C code for avr-gcc -O2, to be
+ *  confirmed with latencyMaxIsr on the target):
+ *    - about 30 for the block counter and the input
+ *    - about 100 per active bin (two 16 x 16 bit multiplications, shifts
+ *      and additions of the 32 bit state)
+ *  Four bins take about 430 cycles. At 1kHz (20000 cycles per sample) that
+ *  is about 2% of the CPU; at the 11.1kHz maximum of the ADC (1800 cycles)
+ *  about 25%, so no more than about eight bins should run at high rates
+ *  together with the filters.
+ */
+
+#ifndef _GOERTZEL_H
+#define _GOERTZEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//! Number of bins
+#define GOERTZEL_BINS 4
+
+//! Default samples per block
+#define GOERTZEL_BLOCK 200
+
+//! Largest block (keeps the 32 bit state from overflowing)
+#define GOERTZEL_MAX_BLOCK 256
+
+//! Sets the samples per block (N) and disables all bins
+void goertzel_init(uint16_t block);
+
+//! Sets the frequency of a bin in Hz at the current ADC rate (0 disables it), false if it is out of range
+bool goertzel_setBin(uint8_t bin, uint16_t hz);
+
+//! Returns the exact frequency of a bin in Hz at the current ADC rate, 0 if the bin is disabled
+uint16_t goertzel_binFrequency(uint8_t bin);
+
+//! Returns the amplitude of a bin in ADC counts, measured over the last complete block
+uint16_t goertzel_amplitude(uint8_t bin);
+
+//! Returns the number of completed blocks (wraps)
+uint8_t goertzel_blocks(void);
+
+//! Feeds a sample (0...1023), called by the ADC ISR
+void goertzel_sample(uint16_t sample);
+
+#endif
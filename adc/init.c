@@ -0,0 +1,77 @@
+#include "init.h"
+#include "adc.h"
+#include "bin_clock.h"
+#include "latency.h"
+#include "lcd.h"
+#include "os_input.h"
+#include "timebase.h"
+
+#include <avr/pgmspace.h>
+
+/*! \file
+ *  Init-once bookkeeping and boot time measurement.
+ */
+
+//! An init function
+typedef void (*InitFunction)(void);
+
+//! Init functions in the order of the INIT_* bits
+static const InitFunction initFunctions[] PROGMEM = {
+    timebase_init,
+    latency_init,
+    os_initInput,
+    initClock,
+    initAdc,
+    lcd_init
+};
+
+//! Modules that have been initialized
+static uint8_t initDone;
+
+//! Microseconds from the start of main to the first menu frame
+static uint32_t initBootTime;
+
+/*!
+ *  Runs the init functions of the passed modules that have not run yet,
+ *  in the order of the INIT_* bits.
+ *
+ *  \param modules  INIT_* bits of the required modules.
+ */
+void init_require(uint8_t modules) {
+    uint8_t pending = modules & ~initDone;
+    uint8_t i;
+
+    for (i = 0; pending; i++, pending >>= 1) {
+        if (pending & 1) {
+            ((InitFunction)pgm_read_ptr(&initFunctions[i]))();
+            initDone |= 1 << i;
+        }
+    }
+}
+
+/*!
+ *  \param modules  INIT_* bits of the modules.
+ *  \return         True if all passed modules have been initialized.
+ */
+bool init_isDone(uint8_t modules) {
+    return (initDone & modules) == modules;
+}
+
+/*!
+ *  Records the time since the timebase was started. Only the first call
+ *  counts. The C startup code before main (a few microseconds) is not
+ *  included.
+ */
+void init_bootFinished(void) {
+    if (!initBootTime) {
+        initBootTime = timebase_micros();
+    }
+}
+
+/*!
+ *  \return Microseconds from the start of main to the first menu frame, or
+ *          0 if the menu has not been drawn yet.
+ */
+uint32_t init_bootTime(void) {
+    return initBootTime;
+}
@@ -0,0 +1,53 @@
+/*! \file
+ *  \brief Initialization of the modules.
+ *
+ *  Keeps track of the modules that have been initialized, so every init
+ *  function runs exactly once no matter how often a program requires it.
+ *  The modules are initialized in the order of their bits. The LCD comes
+ *  last: its power-up time is counted from the start of the timebase, so
+ *  the other initializations run during that time instead of before it.
+ *
+ *  The time from the start of main to the first frame of the menu is kept
+ *  as diagnostic (init_bootTime).
+ */
+
+#ifndef _INIT_H
+#define _INIT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//! Timebase (Timer0), first so that the boot time is measured
+#define INIT_TIMEBASE 0x01
+
+//! Latency instrumentation (Timer1)
+#define INIT_LATENCY 0x02
+
+//! Buttons and their debouncing
+#define INIT_INPUT 0x04
+
+//! Binary clock
+#define INIT_CLOCK 0x08
+
+//! ADC
+#define INIT_ADC 0x10
+
+//! LCD, last so that its power-up wait overlaps the others
+#define INIT_LCD 0x20
+
+//! All modules
+#define INIT_ALL (INIT_TIMEBASE | INIT_LATENCY | INIT_INPUT | INIT_CLOCK | INIT_ADC | INIT_LCD)
+
+//! Initializes the passed modules (INIT_*) unless they already are
+void init_require(uint8_t modules);
+
+//! Returns whether all passed modules have been initialized
+bool init_isDone(uint8_t modules);
+
+//! Records the boot time, called once the first menu frame has been drawn
+void init_bootFinished(void);
+
+//! Returns the microseconds from the start of main to the first menu frame (0 = still booting)
+uint32_t init_bootTime(void);
+
+#endif
@@ -0,0 +1,59 @@
+#include "latency.h"
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <util/atomic.h>
+
+/*! \file
+ *  Free-running Timer1 and the ISR entry latency probe.
+ */
+
+volatile uint16_t latencyMaxIrqOff;
+volatile uint16_t latencyMaxIsr;
+volatile uint16_t latencyMaxEntry;
+
+/*!
+ *  Starts Timer1 in normal mode (free running) with prescaler 8 and enables
+ *  the probe on compare match A.
+ */
+void latency_init(void) {
+#if LATENCY_ENABLED
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        TCCR1A = 0;
+        TCCR1B = (1 << CS11);
+        TCNT1 = 0;
+        OCR1A = LATENCY_PROBE_COUNTS;
+        TIFR1 = (1 << OCF1A);
+        TIMSK1 |= (1 << OCIE1A);
+    }
+    sei();
+#endif
+    latency_reset();
+}
+
+/*!
+ *  Clears all high-water marks.
+ */
+void latency_reset(void) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        latencyMaxIrqOff = 0;
+        latencyMaxIsr = 0;
+        latencyMaxEntry = 0;
+    }
+}
+
+#if LATENCY_ENABLED
+/*!
+ *  Latency probe. Measures how long after the compare match it started and
+ *  schedules the next match.
+ */
+ISR(TIMER1_COMPA_vect) {
+    uint16_t const match = OCR1A;
+    uint16_t const late = TCNT1 - match;
+
+    if (late > latencyMaxEntry) {
+        latencyMaxEntry = late;
+    }
+    OCR1A = match + LATENCY_PROBE_COUNTS;
+}
+#endif
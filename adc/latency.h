@@ -0,0 +1,132 @@
+/*! \file
+ *  \brief Interrupt latency instrumentation.
+ *
+ *  Timer1 runs free at F_CPU / 8 (0.4us per count at 20MHz, wraps after
+ *  26ms) and is used to keep three high-water marks:
+ *    - the longest window with interrupts disabled in a critical section
+ *      that uses latency_irqOff/latency_irqRestore,
+ *    - the longest run of an instrumented ISR (latency_isrDone), during
+ *      which interrupts are disabled as well,
+ *    - the longest ISR entry latency: a probe interrupt on compare match A
+ *      fires about every millisecond and measures how long after the match
+ *      it actually starts. Its period is not a multiple of the timebase
+ *      tick, so it hits every phase of the other activity. The measured
+ *      value includes the interrupt response and the ISR prologue (about
+ *      1us).
+ *
+ *  Bounds of the interrupt-off windows (estimated from the code, to be
+ *  checked with the high-water marks on the target):
+ *    - LCD driver: at most one busy flag poll or one byte transfer, below
+ *      5us (LATENCY_LCD_BOUND_US)
+ *    - other critical sections (timebase, scheduler, LEDs, buttons): below
+ *      2us
+ *    - timebase tick ISR (clock, buttons, LED PWM): below 20us
+ *
+ *  With LATENCY_ENABLED 0 the critical sections still disable interrupts
+ *  but nothing is measured and Timer1 is not used.
+ */
+
+#ifndef _LATENCY_H
+#define _LATENCY_H
+
+#include <stdint.h>
+#include <avr/interrupt.h>
+#include <avr/io.h>
+
+//! Set to 0 to remove the instrumentation
+#define LATENCY_ENABLED 1
+
+//! Prescaler of Timer1
+#define LATENCY_PRESCALER 8
+
+//! Counts between two runs of the probe (about 1ms, coprime to the tick)
+#define LATENCY_PROBE_COUNTS 2503
+
+//! Documented bound of an interrupt-off window of the LCD driver
+#define LATENCY_LCD_BOUND_US 5
+
+//! Converts Timer1 counts to microseconds
+#define LATENCY_TO_US(counts) ((uint16_t)(((uint32_t)(counts) * LATENCY_PRESCALER * 1000UL) / (F_CPU / 1000UL)))
+
+//! Saved interrupt state and start of a critical section
+typedef struct {
+    uint8_t sreg;   //!< SREG before the section
+    uint16_t start; //!< Timer1 count at the start of the section
+} IrqWindow;
+
+//! Longest interrupt-off window of the critical sections in Timer1 counts
+extern volatile uint16_t latencyMaxIrqOff;
+
+//! Longest run of an instrumented ISR in Timer1 counts
+extern volatile uint16_t latencyMaxIsr;
+
+//! Longest ISR entry latency of the probe in Timer1 counts
+extern volatile uint16_t latencyMaxEntry;
+
+//! Starts Timer1 and the probe
+void latency_init(void);
+
+//! Clears the high-water marks
+void latency_reset(void);
+
+/*!
+ *  Disables interrupts and starts timing the window.
+ *
+ *  \return The state to be passed to latency_irqRestore.
+ */
+static inline IrqWindow latency_irqOff(void) {
+    IrqWindow window;
+    window.sreg = SREG;
+    cli();
+#if LATENCY_ENABLED
+    window.start = TCNT1;
+#endif
+    return window;
+}
+
+/*!
+ *  Ends a window started by latency_irqOff and restores the interrupt flag.
+ *  Only the outermost window (interrupts were enabled before) is recorded.
+ *
+ *  \param window  The state returned by latency_irqOff.
+ */
+static inline void latency_irqRestore(IrqWindow window) {
+#if LATENCY_ENABLED
+    if (window.sreg & (1 << SREG_I)) {
+        uint16_t const duration = TCNT1 - window.start;
+        if (duration > latencyMaxIrqOff) {
+            latencyMaxIrqOff = duration;
+        }
+    }
+#endif
+    SREG = window.sreg;
+}
+
+/*!
+ *  \return The current count of Timer1, e.g. at the start of an ISR.
+ */
+static inline uint16_t latency_now(void) {
+#if LATENCY_ENABLED
+    return TCNT1;
+#else
+    return 0;
+#endif
+}
+
+/*!
+ *  Records the run time of an ISR, called at its end.
+ *
+ *  \param start  latency_now() at the start of the ISR.
+ */
+static inline void latency_isrDone(uint16_t start) {
+#if LATENCY_ENABLED
+    uint16_t const duration = TCNT1 - start;
+    if (duration > latencyMaxIsr) {
+        latencyMaxIsr = duration;
+    }
+#else
+    (void)start;
+#endif
+}
+
+#endif
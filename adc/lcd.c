@@ -1,12 +1,17 @@
 #include "lcd.h"
+#include "lcd_glyph.h"
+#include "lcd_viewport.h"
+#include "fmt.h"
+#include "latency.h"
+#include "timebase.h"
 #ifdef VERSUCH
     #include "util.h"
 #endif
 
+#include <stdarg.h>
 #include <stdio.h>
 #include <avr/interrupt.h>
 #include <avr/io.h>
-#include <util/atomic.h>
 #include <util/delay.h>
 
 //! Global var, stores character count.
@@ -17,6 +22,25 @@
  */
 uint8_t charCtr;
 
+//! Bitmaps of the custom chars used by lcd_writeChar, indexed by LCD_CC_*
+static const uint64_t lcd_customChars[] PROGMEM = {
+    LCD_CC_IXI_BITMAP,
+    LCD_CC_TILDE_BITMAP,
+    LCD_CC_BACKSLASH_BITMAP,
+    LCD_CC_MU_BITMAP
+};
+
+/*!
+ *  Returns the character code of a custom char of the driver. The char is
+ *  uploaded through the glyph cache on its first use.
+ *  \internal
+ *
+ *  \param cc  One of LCD_CC_*.
+ */
+static uint8_t lcd_customChar(uint8_t cc) {
+    return lcd_glyphLoadProg(LCD_GLYPH_BUILTIN + cc, (const uint8_t *)&lcd_customChars[cc]);
+}
+
 /*!
  *  Internally used to turn on LCD Pin EN (Enable) for 1us.
  *  \internal
@@ -34,28 +58,43 @@ static int lcd_writeWrapper(const char c, FILE *stream) {
 
 FILE *lcdout = &(FILE)FDEV_SETUP_STREAM(lcd_writeWrapper, NULL, _FDEV_SETUP_WRITE);
 
+/*!
+ *  Sink for the compact formatter (see fmt.h).
+ *  \internal
+ */
+static void lcd_fmtSink(char c, void *context) {
+    lcd_writeChar(c);
+}
+
 /*!
  *  Prepares the LCD to be used with the defined output-port.
- *  Delay times as specified with some reserve
+ *  Delay times as specified with some reserve. The power-up time is counted
+ *  from the start of the timebase, so only the part of it that has not been
+ *  spent by other initializations is waited for.
  */
 void lcd_init(void) {
     // Write on LCD Port (reading is not needed)
     LCD_PORT_DDR = 0xFF;
 
     // Init routine (see specifications)
-    delayMs(15);
+    timebase_init();
+    while (timebase_millis() < LCD_POWER_UP_MS) {
+        // Wait for the rest of the power-up time
+    }
     LCD_PORT_DATA = LCD_INIT;
     lcd_enable();
-    delayMs(5);
+    delayMs(5);     // > 4.1ms
     lcd_enable();
-    delayMs(1);
+    _delay_us(150); // > 100us
     lcd_enable();
-    delayMs(1);
+    _delay_us(150);
 
     // LCD is connected with 4 pins for data
     LCD_PORT_DATA = LCD_4BIT_MODE;
     lcd_enable();
-    delayMs(1);
+    _delay_us(150);
+
+    // From here on, the busy flag is checked before every command
 
     // Display type is 2 line / 5x7 character set
     lcd_command(LCD_TWO_LINES | LCD_5X7);
@@ -65,13 +104,8 @@ void lcd_init(void) {
     lcd_command(LCD_NO_INC_ADDR | LCD_NO_MOVE);
     lcd_clear();
 
-    // Register custom characters
-    lcd_registerCustomChar(LCD_CC_IXI,        LCD_CC_IXI_BITMAP);
-    lcd_registerCustomChar(LCD_CC_TILDE,      LCD_CC_TILDE_BITMAP);
-    lcd_registerCustomChar(LCD_CC_BACKSLASH,  LCD_CC_BACKSLASH_BITMAP);
-    lcd_registerCustomChar(LCD_CC_MU,         LCD_CC_MU_BITMAP);
-
-    lcd_clear();
+    // Custom characters are uploaded on their first use (see lcd_glyph.h)
+    lcd_glyphReset();
 }
 
 /*!
@@ -149,20 +183,24 @@ void lcd_goto(unsigned char row, unsigned char column) {
  *  holds a command or a printable char.
  *  This function is used by lcd_command and lcd_writeChar.
  *
+ *  Interrupts are only disabled for a single poll of the busy flag or for
+ *  the transfer of the two nibbles (below LATENCY_LCD_BOUND_US each), never
+ *  while waiting for the LCD. The LCD is only written by the main program,
+ *  an ISR in between merely stretches the enable pulse or the wait.
+ *
  *  \param firstByte The first value to send.
  *  \param secondByte The second value to send.
  */
 void lcd_sendStream(uint8_t firstByte, uint8_t secondByte) {
-    // Check if interrupts are set and store that state
-    uint8_t sreg = SREG & (1 << 7);
-
-    // Interrupts off
-    cli();
     uint16_t iterations = 0;
     bool busy = false;
+    IrqWindow window;
 
     // Wait while LCD is busy or timeout was reached
     do {
+        // Interrupts off for this poll only
+        window = latency_irqOff();
+
         // Read busy flag state:
         // Set R/W port to high, all others to low
         LCD_PORT_DATA = 0x40;
@@ -185,19 +223,20 @@ void lcd_sendStream(uint8_t firstByte, uint8_t secondByte) {
         // Second nibble is not used, waste it by calling lcd_enable
         lcd_enable();
 
+        // Restore interrupt flag
+        latency_irqRestore(window);
+
         // Increase count of iterations
         iterations++;
         if (iterations == LCD_BUSY_TIMEOUT) {
             // Timeout: Try to reset LCD
             lcd_enable();
-
-            // Restore interrupt flag
-            SREG |= sreg;
             return;
         }
     } while (busy);
 
     // Transmit command:
+    window = latency_irqOff();
     LCD_PORT_DDR = 0xFF;
 
     // Send first Byte
@@ -209,7 +248,62 @@ void lcd_sendStream(uint8_t firstByte, uint8_t secondByte) {
     lcd_enable();
 
     // Restore interrupt flag
-    SREG |= sreg;
+    latency_irqRestore(window);
+}
+
+/*!
+ *  Reads the busy flag and the address counter of the LCD (both nibbles).
+ *  \internal
+ *
+ *  \return Busy flag in bit 7, address counter in bits 6...0.
+ */
+static uint8_t lcd_readStatus(void) {
+    uint8_t high, low;
+    IrqWindow const window = latency_irqOff();
+
+    // Set R/W port to high, all others to low
+    LCD_PORT_DATA = 0x40;
+
+    // Enable reading from pins 1 to 4 with pull-ups
+    LCD_PORT_DDR = 0xF0;
+    LCD_PORT_DATA |= 0x0F;
+
+    // First nibble: busy flag and address bits 6...4
+    sbi(LCD_PORT_DATA, 5);
+    _delay_us(1);
+    high = LCD_PIN & 0x0F;
+    cbi(LCD_PORT_DATA, 5);
+
+    // Second nibble: address bits 3...0
+    sbi(LCD_PORT_DATA, 5);
+    _delay_us(1);
+    low = LCD_PIN & 0x0F;
+    cbi(LCD_PORT_DATA, 5);
+
+    latency_irqRestore(window);
+    return (high << 4) | low;
+}
+
+/*!
+ *  Reads the DDRAM address of the cursor from the LCD. Unlike charCtr it
+ *  covers all 40 columns of a line and is not affected by a display shift.
+ *  \internal
+ *
+ *  \return The address (0x00...0x27 on line 1, 0x40...0x67 on line 2).
+ */
+static uint8_t lcd_readAddress(void) {
+    uint16_t iterations = 0;
+
+    // Wait while LCD is busy or timeout was reached
+    while (lcd_readStatus() & 0x80) {
+        if (++iterations == LCD_BUSY_TIMEOUT) {
+            break;
+        }
+    }
+
+    // The address counter is updated shortly after the busy flag is cleared
+    _delay_us(4);
+    return lcd_readStatus() & 0x7F;
 }
 
 /*!
@@ -231,85 +325,98 @@ void lcd_command(uint8_t command) {
  *  \param character  The character to be written.
  */
 void lcd_writeChar(char character) {
-    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { // Turn of interrupts
-
-        // For UTF-8 multibyte code point
-        static uint32_t codePoint = 0;
-        static uint8_t expectedBytes = 0;
-
-        // Handle UTF-8
-        if (!expectedBytes) { // New code point
-            codePoint = character;
-            if (character <= 0x7F) expectedBytes = 0; // 1 byte code points
-            else if (character <= 0xBF) { // No more continuation byte expected
-                codePoint = 0xE296A1;
-                expectedBytes = 0;
-            }
-            else if (character <= 0xDF) expectedBytes = 1; // 2 byte code points
-            else if (character <= 0xEF) expectedBytes = 2; // 3 byte code points
-            else if (character <= 0xFF) expectedBytes = 3; // 4 byte code points
-        } else { // Continuation byte expected
-            if (0x80 <= character && character <= 0xBF) { // Continuation byte
-                codePoint = (codePoint << 8) | character;
-                expectedBytes--;
-            } else { // No new code point expected
-                codePoint = 0xE296A1;
-                expectedBytes = 0;
-            }
+    // Interrupts stay enabled: the decoder state is only used by the main
+    // program, the transfer itself is protected by lcd_sendStream
+
+    // For UTF-8 multibyte code point
+    static uint32_t codePoint = 0;
+    static uint8_t expectedBytes = 0;
+
+    // Handle UTF-8
+    if (!expectedBytes) { // New code point
+        codePoint = character;
+        if (character <= 0x7F) expectedBytes = 0; // 1 byte code points
+        else if (character <= 0xBF) { // No more continuation byte expected
+            codePoint = 0xE296A1;
+            expectedBytes = 0;
         }
-
-        // Don't print UTF-8 special bytes
-        if (expectedBytes) return;
-
-        // Check if line shall be changed
-        if (codePoint == '\n') {
-            charCtr = charCtr < 0x10 ? 0x10 : 0x20;
-        }
-        if (charCtr == 0x10) {
-            lcd_line2();
-        } else if (charCtr == 0x20) {
-            lcd_clear();
-            lcd_line1();
+        else if (character <= 0xDF) expectedBytes = 1; // 2 byte code points
+        else if (character <= 0xEF) expectedBytes = 2; // 3 byte code points
+        else if (character <= 0xFF) expectedBytes = 3; // 4 byte code points
+    } else { // Continuation byte expected
+        if (0x80 <= character && character <= 0xBF) { // Continuation byte
+            codePoint = (codePoint << 8) | character;
+            expectedBytes--;
+        } else { // No new code point expected
+            codePoint = 0xE296A1;
+            expectedBytes = 0;
         }
+    }
 
-        if (codePoint == '\n') return;
-
-        // A remapping from UTF-8 to LCD
-        #define REMAP(UTF8, LCD) case UTF8: character = LCD; break
-        switch (codePoint) {
-            REMAP(0x5C    , LCD_CC_BACKSLASH); // '\'
-            REMAP(0x7E    , LCD_CC_TILDE    ); // ~
-            REMAP(0xC2A5  , 0x5C            ); // ¥
-            REMAP(0xC2B0  , 0xDF            ); // °
-            REMAP(0xC2B5  , 0xE4            ); // µ
-            REMAP(0xC39F  , 0xE2            ); // ß
-            REMAP(0xC3A4  , 0xE1            ); // ä
-            REMAP(0xC3B6  , 0xEF            ); // ö
-            REMAP(0xC3B7  , 0xFD            ); // ÷
-            REMAP(0xC3BC  , 0xF5            ); // ü
-            REMAP(0xCEA3  , 0xF6            ); // Σ
-            REMAP(0xCEA9  , 0xF4            ); // Ω
-            REMAP(0xCEB1  , 0xE0            ); // α
-            REMAP(0xCEB5  , 0xE3            ); // ε
-            REMAP(0xCEBC  , LCD_CC_MU       ); // μ
-            REMAP(0xCF80  , 0xF7            ); // π
-            REMAP(0xCF81  , 0xE6            ); // ρ
-            REMAP(0xCF83  , 0xE5            ); // σ
-            REMAP(0xE285BA, LCD_CC_IXI      ); // ⅺ
-            REMAP(0xE28690, 0x7F            ); // ←
-            REMAP(0xE28692, 0x7E            ); // →
-            REMAP(0xE2889A, 0xE8            ); // √
-            REMAP(0xE296A1, 0xDB            ); // □
-            REMAP(0xE296AE, 0xFF            ); // ▮
-            default: character = codePoint <= 0x7F ? codePoint : character; break;
-        }
-        #undef REMAP
+    // Don't print UTF-8 special bytes
+    if (expectedBytes) return;
 
-        lcd_sendStream(0x10 | ((character & 0xF0) >> 4), 0x10 | (character & 0x0F));
+    // Check if line shall be changed
+    if (codePoint == '\n') {
+        charCtr = charCtr < 0x10 ? 0x10 : 0x20;
+    }
+    if (charCtr == 0x10) {
+        lcd_line2();
+    } else if (charCtr == 0x20) {
+        lcd_clear();
+        lcd_line1();
+    }
 
-        // Update char counter ... Do not modulo it down! we need it to become 32
-        charCtr++;
+    if (codePoint == '\n') return;
+
+    // A remapping from UTF-8 to LCD
+    #define REMAP(UTF8, LCD) case UTF8: character = LCD; break
+    #define REMAP_CC(UTF8, CC) case UTF8: character = lcd_customChar(CC); break
+    switch (codePoint) {
+        REMAP_CC(0x5C    , LCD_CC_BACKSLASH); // '\'
+        REMAP_CC(0x7E    , LCD_CC_TILDE    ); // ~
+        REMAP(0xC2A5  , 0x5C            ); // ¥
+        REMAP(0xC2B0  , 0xDF            ); // °
+        REMAP(0xC2B5  , 0xE4            ); // µ
+        REMAP(0xC39F  , 0xE2            ); // ß
+        REMAP(0xC3A4  , 0xE1            ); // ä
+        REMAP(0xC3B6  , 0xEF            ); // ö
+        REMAP(0xC3B7  , 0xFD            ); // ÷
+        REMAP(0xC3BC  , 0xF5            ); // ü
+        REMAP(0xCEA3  , 0xF6            ); // Σ
+        REMAP(0xCEA9  , 0xF4            ); // Ω
+        REMAP(0xCEB1  , 0xE0            ); // α
+        REMAP(0xCEB5  , 0xE3            ); // ε
+        REMAP_CC(0xCEBC  , LCD_CC_MU       ); // μ
+        REMAP(0xCF80  , 0xF7            ); // π
+        REMAP(0xCF81  , 0xE6            ); // ρ
+        REMAP(0xCF83  , 0xE5            ); // σ
+        REMAP_CC(0xE285BA, LCD_CC_IXI      ); // ⅺ
+        REMAP(0xE28690, 0x7F            ); // ←
+        REMAP(0xE28692, 0x7E            ); // →
+        REMAP(0xE2889A, 0xE8            ); // √
+        REMAP(0xE296A1, 0xDB            ); // □
+        REMAP(0xE296AE, 0xFF            ); // ▮
+        default: character = codePoint <= 0x7F ? codePoint : character; break;
     }
+    #undef REMAP
+    #undef REMAP_CC
+
+    lcd_writeRawChar(character);
+}
+
+/*!
+ *  Writes one character code of the LCD character set (including the custom
+ *  chars 0...7) at the current position. There is neither UTF-8 decoding nor
+ *  automatic line handling.
+ *
+ *  \param code  The character code to be written.
+ */
+void lcd_writeRawChar(uint8_t code) {
+    lcd_sendStream(0x10 | ((code & 0xF0) >> 4), 0x10 | (code & 0x0F));
+
+    // Update char counter ... Do not modulo it down! we need it to become 32
+    charCtr++;
 }
 
 /*!
@@ -318,6 +425,9 @@ void lcd_writeChar(char character) {
 void lcd_clear(void) {
     charCtr = 0;
     lcd_command(LCD_CLEAR);
+
+    // Clearing also resets the display shift
+    lcd_viewportReset();
 }
 
 /*!
@@ -411,20 +521,52 @@ void lcd_writeHex(uint16_t number) {
  *  Writes a 16 bit integer as a decimal number without leading 0s
  */
 void lcd_writeDec(uint16_t number) {
-    if (!number) {
-        lcd_writeChar('0');
-        return;
-    }
+    fmt_unsigned(lcd_fmtSink, NULL, number, 0, ' ');
+}
 
-    uint32_t pos = 10000;
-    uint8_t print = 0;
-    do {
-        uint8_t const digit = number / pos;
-        number -= digit * pos;
-        if (print |= digit) {
-            lcd_writeChar(digit + '0');
-        }
-    } while (pos /= 10);
+/*!
+ *  Writes a 16 bit integer as a decimal number padded with leading 0s
+ *
+ *  \param number  The number to be written.
+ *  \param width   Minimum number of digits (e.g. 3 writes 7 as "007").
+ */
+void lcd_writePaddedDec(uint16_t number, uint8_t width) {
+    fmt_unsigned(lcd_fmtSink, NULL, number, width, '0');
+}
+
+/*!
+ *  Writes two packed BCD digits (e.g. 0x59 as "59").
+ *
+ *  \param bcd  The digits, tens in the upper nibble.
+ */
+void lcd_writeBcd(uint8_t bcd) {
+    lcd_writeChar('0' + (bcd >> 4));
+    lcd_writeChar('0' + (bcd & 0x0F));
+}
+
+/*!
+ *  Writes a fixed-point number, i.e. an integer holding the value scaled
+ *  by 10^decimals. For example 4987 with 3 decimals is written as "4.987".
+ *
+ *  \param value     The scaled value to be written.
+ *  \param decimals  Number of digits behind the decimal point.
+ */
+void lcd_writeFixed(int32_t value, uint8_t decimals) {
+    fmt_fixed(lcd_fmtSink, NULL, value, decimals, 0, ' ');
+}
+
+/*!
+ *  Writes a format string from the program flash memory. Supports the
+ *  conversions of the compact formatter (see fmt.h), e.g.
+ *  lcd_printf_P(PSTR("%02u:%02u %.3kV"), hour, minute, millivolts).
+ *
+ *  \param format  Format string in the program flash memory.
+ */
+void lcd_printf_P(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    fmt_vformat_P(lcd_fmtSink, NULL, format, args);
+    va_end(args);
 }
 
 /*!
@@ -486,7 +628,11 @@ void lcd_writeProgString(char const* string) {
  *  \param string  The string to be written (a pointer to the first character).
  */
 void lcd_writeErrorProgString(char const* string) {
-    fprintf_P(stderr, string);
+#if FMT_STDIO_SHIM
+    fmt_fprintf_P(stderr, string);
+#else
+    lcd_writeProgString(string);
+#endif
 }
 
 /*!
@@ -497,19 +643,23 @@ void lcd_writeErrorProgString(char const* string) {
  *  \param chr The passed value is one 32 bit integer witch holds all rows of the character.
  */
 void lcd_registerCustomChar(uint8_t addr, uint64_t chr) {
-    uint8_t const sreg = SREG & (1 << 7);
-    cli();
+    // The CGRAM address replaces the cursor position, which may be anywhere
+    // in the 40 columns of a line (e.g. during a viewport write)
+    uint8_t const ddramAddress = lcd_readAddress();
+
+    // Every byte waits for the busy flag, so no fixed delays are needed and
+    // interrupts are only disabled per byte (see lcd_sendStream)
     lcd_command(0x40 | (0x38 & (addr << 3)));
-    _delay_us(40);
 
     uint8_t i = 8;
     while (i--) {
         uint8_t const row = chr & 0xFF;
         lcd_sendStream(((1 << LCD_RS_PIN) & 0xF0) | ((row >> 4) & 0xF), ((1 << LCD_RS_PIN) & 0xF0) | (row & 0xF));
-        _delay_us(40);
         chr >>= 8;
     }
-    SREG |= sreg;
+
+    // Point the address counter back to the cursor position in the DDRAM
+    lcd_command(LCD_CURSOR_MOVE_R | ddramAddress);
 }
 
 /*!
@@ -523,30 +673,16 @@ void lcd_write32bitHex(uint32_t number) {
     lcd_writeHexWord(number);
 }
 
-/*! \brief Prints the passed voltage onto the display (three float places).
+/*! \brief Prints the passed voltage onto the display (three decimal places).
  *
  * \param voltage           Binary voltage value.
  * \param valueUpperBound   Upper bound of the binary voltage value (i.e. 1023 for 10-bit value).
  * \param voltUpperBound    Upper bound of the float voltage value (i.e. 5 for 5V).
  */
 void lcd_writeVoltage(uint16_t voltage, uint16_t valueUpperBound, uint8_t voltUpperBound) {
-    uint8_t  intVal;
-    uint16_t floatVal;
-
-    // Calculate integer and float part of the voltage
-    voltage *= voltUpperBound;
-    intVal   = voltage / valueUpperBound;
-    floatVal = (uint32_t)(voltage - (intVal * valueUpperBound)) * 1000 / valueUpperBound;
-
-    // Show voltage on display
-    lcd_writeDec(intVal);
-    lcd_writeChar('.');
-    if (floatVal < 100) {
-        lcd_writeChar('0');
-    }
-    if (floatVal < 10) {
-        lcd_writeChar('0');
-    }
-    lcd_writeDec(floatVal);
+    // Scale to millivolts and print as fixed-point number with three decimals
+    uint32_t const millivolts = (uint32_t)voltage * voltUpperBound * 1000 / valueUpperBound;
+
+    lcd_writeFixed(millivolts, 3);
     lcd_writeChar('V');
 }
@@ -55,6 +55,9 @@
     #define LCD_PIN PINA
 #endif
 
+//! Milliseconds after power-up before the LCD accepts the init sequence
+#define LCD_POWER_UP_MS 15
+
 //! First value for init
 #define LCD_INIT 0x03
 
@@ -142,6 +145,8 @@
 
 //----------------------------------------------------------------------------
 // Custom Chars
+// These are loaded through the glyph cache on first use (see lcd_glyph.h),
+// so the numbers are logical IDs and not CGRAM addresses.
 //----------------------------------------------------------------------------
 
 // Note: 8===0
@@ -233,6 +238,9 @@ void lcd_erase(uint8_t line);
 //! Write one character
 void lcd_writeChar(char character);
 
+//! Write one character code without UTF-8 decoding or line handling
+void lcd_writeRawChar(uint8_t code);
+
 //! Write a half-byte (a nibble)
 void lcd_writeHexNibble(uint8_t number);
 
@@ -248,6 +256,18 @@ void lcd_writeHex(uint16_t number);
 //! Write a byte as a decimal number without prefixes
 void lcd_writeDec(uint16_t number);
 
+//! Write a decimal number padded with leading 0s to width digits
+void lcd_writePaddedDec(uint16_t number, uint8_t width);
+
+//! Write two packed BCD digits
+void lcd_writeBcd(uint8_t bcd);
+
+//! Write a fixed-point number scaled by 10^decimals
+void lcd_writeFixed(int32_t value, uint8_t decimals);
+
+//! Write a formatted PROGMEM string (see fmt.h for the supported conversions)
+void lcd_printf_P(const char *format, ...);
+
 //! Write text string
 void lcd_writeString(char const* text);
 
@@ -0,0 +1,106 @@
+#include "lcd_bar.h"
+#include "lcd.h"
+#include "lcd_glyph.h"
+
+/*! \file
+ *  Incremental bar graph with sub-character resolution.
+ */
+
+//! Character code of a completely filled cell (built-in block character)
+#define LCD_BAR_FULL 0xFF
+
+//! Character code of an empty cell
+#define LCD_BAR_EMPTY ' '
+
+//! Marks a cell whose content on the display is unknown
+#define LCD_BAR_UNKNOWN 0xFE
+
+//! Character codes currently shown on the lines
+static uint8_t barShadow[2][LCD_BAR_CELLS];
+
+/*!
+ *  Returns the character code of a cell with 1...4 filled pixel columns.
+ *  The custom char is uploaded if it is not in the glyph cache.
+ *  \internal
+ */
+static uint8_t lcd_barPartial(uint8_t columns) {
+    uint16_t const id = LCD_GLYPH_BAR + columns - 1;
+    uint8_t code = lcd_glyphFind(id);
+
+    if (code == LCD_GLYPH_MISS) {
+        // Fill the left pixel columns in all eight rows
+        uint8_t const row = (0x1F << (LCD_BAR_CELL_STEPS - columns)) & 0x1F;
+        uint64_t bitmap = 0;
+        uint8_t i;
+        for (i = 0; i < 8; i++) {
+            bitmap = (bitmap << 8) | row;
+        }
+        code = lcd_glyphStore(id, bitmap);
+    }
+    return code;
+}
+
+/*!
+ *  Marks both lines as unknown, so the next lcd_barDraw redraws them.
+ */
+void lcd_barInit(void) {
+    lcd_barReset(1);
+    lcd_barReset(2);
+}
+
+/*!
+ *  Forgets the content of the passed line, so the next lcd_barDraw writes
+ *  every cell. Needs to be called whenever the line was changed by other
+ *  functions, e.g. lcd_clear.
+ *
+ *  \param line  The line (1 or 2).
+ */
+void lcd_barReset(uint8_t line) {
+    uint8_t i;
+    for (i = 0; i < LCD_BAR_CELLS; i++) {
+        barShadow[(line - 1) & 1][i] = LCD_BAR_UNKNOWN;
+    }
+}
+
+/*!
+ *  Draws a bar on the passed line. Cells that already show the right
+ *  character are skipped, so small changes of the value cost one or two
+ *  character transfers instead of a cleared and rewritten line.
+ *
+ *  \param line   The line (1 or 2).
+ *  \param value  Length of the bar in pixel columns (0...LCD_BAR_STEPS).
+ */
+void lcd_barDraw(uint8_t line, uint8_t value) {
+    uint8_t *const shadow = barShadow[(line - 1) & 1];
+    uint8_t cursor = LCD_BAR_CELLS; // Cell the LCD cursor points to
+    uint8_t i;
+
+    if (value > LCD_BAR_STEPS) {
+        value = LCD_BAR_STEPS;
+    }
+
+    for (i = 0; i < LCD_BAR_CELLS; i++) {
+        uint8_t code;
+        if (value >= LCD_BAR_CELL_STEPS) {
+            code = LCD_BAR_FULL;
+            value -= LCD_BAR_CELL_STEPS;
+        } else if (value) {
+            code = lcd_barPartial(value);
+            value = 0;
+        } else {
+            code = LCD_BAR_EMPTY;
+        }
+
+        if (shadow[i] == code) {
+            continue;
+        }
+
+        // Only position the cursor if the last written cell was not the left neighbor
+        if (cursor != i) {
+            lcd_goto(line, i + 1);
+        }
+        lcd_writeRawChar(code);
+        shadow[i] = code;
+        cursor = i + 1;
+    }
+}
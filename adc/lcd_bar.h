@@ -0,0 +1,33 @@
+/*! \file
+ *  \brief Bar graph widget for the LCD.
+ *
+ *  Draws a horizontal bar over a full line with a resolution of five steps
+ *  per character (one step per pixel column). Partially filled cells use
+ *  custom chars from the glyph cache, and on every update only the cells
+ *  that differ from the last drawn bar are sent to the display.
+ */
+
+#ifndef _LCD_BAR_H
+#define _LCD_BAR_H
+
+#include <stdint.h>
+
+//! Pixel columns per character
+#define LCD_BAR_CELL_STEPS 5
+
+//! Characters per line
+#define LCD_BAR_CELLS 16
+
+//! Maximum value of a bar (one step per pixel column)
+#define LCD_BAR_STEPS (LCD_BAR_CELLS * LCD_BAR_CELL_STEPS)
+
+//! Forgets what has been drawn on both lines so far
+void lcd_barInit(void);
+
+//! Forgets what has been drawn on the line (e.g. after lcd_clear)
+void lcd_barReset(uint8_t line);
+
+//! Draws a bar with value (0...LCD_BAR_STEPS) steps on the line (1 or 2)
+void lcd_barDraw(uint8_t line, uint8_t value);
+
+#endif
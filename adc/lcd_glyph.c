@@ -0,0 +1,126 @@
+#include "lcd_glyph.h"
+#include "lcd.h"
+
+#include <avr/pgmspace.h>
+
+/*! \file
+ *  LRU cache for the CGRAM slots of the LCD.
+ */
+
+//! Logical ID of the glyph in each slot
+static uint16_t glyphIds[LCD_GLYPH_SLOTS];
+
+//! Slots ordered by their last use, most recently used first
+static uint8_t glyphOrder[LCD_GLYPH_SLOTS];
+
+//! Number of uploads since the last reset
+static uint16_t glyphUploadCount;
+
+/*!
+ *  Moves the slot at position pos of the usage order to the front.
+ *  \internal
+ */
+static void lcd_glyphTouch(uint8_t pos) {
+    uint8_t const slot = glyphOrder[pos];
+    while (pos) {
+        glyphOrder[pos] = glyphOrder[pos - 1];
+        pos--;
+    }
+    glyphOrder[0] = slot;
+}
+
+/*!
+ *  Marks all slots as free. Needs to be called whenever the CGRAM content is
+ *  lost or was written without the cache, e.g. by lcd_init.
+ */
+void lcd_glyphReset(void) {
+    uint8_t i;
+    for (i = 0; i < LCD_GLYPH_SLOTS; i++) {
+        glyphIds[i] = LCD_GLYPH_NONE;
+        // Slot 0 is the first to be used
+        glyphOrder[i] = LCD_GLYPH_SLOTS - 1 - i;
+    }
+    glyphUploadCount = 0;
+}
+
+/*!
+ *  Looks up a glyph and marks it as most recently used.
+ *
+ *  \param id  Logical ID of the glyph.
+ *  \return    The slot (i.e. the character code) or LCD_GLYPH_MISS.
+ */
+uint8_t lcd_glyphFind(uint16_t id) {
+    uint8_t pos;
+    // Search in usage order, so frequently used glyphs are found first
+    for (pos = 0; pos < LCD_GLYPH_SLOTS; pos++) {
+        uint8_t const slot = glyphOrder[pos];
+        if (glyphIds[slot] == id) {
+            lcd_glyphTouch(pos);
+            return slot;
+        }
+    }
+    return LCD_GLYPH_MISS;
+}
+
+/*!
+ *  Uploads a glyph. A resident glyph with the same ID is overwritten in its
+ *  slot, otherwise the least recently used slot is taken.
+ *
+ *  \param id      Logical ID of the glyph.
+ *  \param bitmap  Eight rows of the glyph (see CUSTOM_CHAR).
+ *  \return        The slot (i.e. the character code).
+ */
+uint8_t lcd_glyphStore(uint16_t id, uint64_t bitmap) {
+    uint8_t slot = lcd_glyphFind(id);
+
+    if (slot == LCD_GLYPH_MISS) {
+        slot = glyphOrder[LCD_GLYPH_SLOTS - 1];
+        lcd_glyphTouch(LCD_GLYPH_SLOTS - 1);
+        glyphIds[slot] = id;
+    }
+
+    lcd_registerCustomChar(slot, bitmap);
+    glyphUploadCount++;
+    return slot;
+}
+
+/*!
+ *  Returns the slot of a glyph and uploads it if it is not resident.
+ *
+ *  \param id      Logical ID of the glyph.
+ *  \param bitmap  Eight rows of the glyph (see CUSTOM_CHAR).
+ *  \return        The slot (i.e. the character code).
+ */
+uint8_t lcd_glyphLoad(uint16_t id, uint64_t bitmap) {
+    uint8_t const slot = lcd_glyphFind(id);
+    return (slot != LCD_GLYPH_MISS) ? slot : lcd_glyphStore(id, bitmap);
+}
+
+/*!
+ *  Returns the slot of a glyph and uploads it from the program flash memory
+ *  if it is not resident.
+ *
+ *  \param id    Logical ID of the glyph.
+ *  \param rows  Eight rows of the glyph in the program flash memory (row 0 first).
+ *  \return      The slot (i.e. the character code).
+ */
+uint8_t lcd_glyphLoadProg(uint16_t id, const uint8_t *rows) {
+    uint8_t const slot = lcd_glyphFind(id);
+    if (slot != LCD_GLYPH_MISS) {
+        return slot;
+    }
+
+    uint64_t bitmap = 0;
+    uint8_t i = 8;
+    while (i--) {
+        bitmap = (bitmap << 8) | pgm_read_byte(rows + i);
+    }
+    return lcd_glyphStore(id, bitmap);
+}
+
+/*!
+ *  \return The number of uploads since the last reset, i.e. the misses.
+ */
+uint16_t lcd_glyphUploads(void) {
+    return glyphUploadCount;
+}
@@ -0,0 +1,58 @@
+/*! \file
+ *  \brief Glyph cache for the custom chars of the LCD.
+ *
+ *  The LCD has only eight CGRAM slots for custom chars, and uploading one
+ *  takes more than 300us with interrupts disabled. The cache maps logical
+ *  glyph IDs to these slots, uploads a glyph on its first use only and
+ *  evicts the least recently used glyph when all slots are taken.
+ *
+ *  Note that a character on the display always shows the current content of
+ *  its slot. Widgets should request all glyphs they show on every redraw,
+ *  so these stay in the cache and evicted ones get redrawn.
+ */
+
+#ifndef _LCD_GLYPH_H
+#define _LCD_GLYPH_H
+
+#include <stdint.h>
+
+//! Number of CGRAM slots of the LCD
+#define LCD_GLYPH_SLOTS 8
+
+//! Returned by lcd_glyphFind if the glyph is not resident
+#define LCD_GLYPH_MISS 0xFF
+
+//! ID of a free slot, must not be used for a glyph
+#define LCD_GLYPH_NONE 0xFFFF
+
+//! Logical IDs of the custom chars of the LCD driver (LCD_CC_* in lcd.h)
+#define LCD_GLYPH_BUILTIN 0x0000
+
+//! Logical IDs of the bar graph (1...4 filled pixel columns)
+#define LCD_GLYPH_BAR 0x0004
+
+//! First logical ID free for other widgets (up to LCD_GLYPH_SPARK - 1)
+#define LCD_GLYPH_USER 0x0010
+
+//! Logical IDs of the sparkline, derived from the content (9^5 IDs)
+#define LCD_GLYPH_SPARK 0x1000
+
+//! Forgets all resident glyphs (e.g. after the LCD was initialized)
+void lcd_glyphReset(void);
+
+//! Returns the slot of a resident glyph or LCD_GLYPH_MISS
+uint8_t lcd_glyphFind(uint16_t id);
+
+//! Uploads a glyph (eight rows as in CUSTOM_CHAR) and returns its slot
+uint8_t lcd_glyphStore(uint16_t id, uint64_t bitmap);
+
+//! Returns the slot of a glyph, the bitmap is uploaded on a miss only
+uint8_t lcd_glyphLoad(uint16_t id, uint64_t bitmap);
+
+//! Returns the slot of a glyph, the eight PROGMEM rows are uploaded on a miss only
+uint8_t lcd_glyphLoadProg(uint16_t id, const uint8_t *rows);
+
+//! Returns the number of uploads since the last reset
+uint16_t lcd_glyphUploads(void);
+
+#endif
@@ -0,0 +1,184 @@
+#include "lcd_spark.h"
+#include "lcd.h"
+#include "lcd_glyph.h"
+
+/*! \file
+ *  Scrolling sparkline built from content-addressed custom chars.
+ */
+
+//! Height of a pixel column without a sample
+#define LCD_SPARK_NONE 0xFF
+
+//! Marks a character whose content on the display is unknown
+#define LCD_SPARK_UNKNOWN 0xFE
+
+//! Position and size of the widget
+static uint8_t sparkLine, sparkColumn, sparkCells, sparkLines;
+
+//! Height of each pixel column, counted from the bottom (oldest sample first)
+static uint8_t sparkHeights[LCD_SPARK_MAX_CELLS * LCD_SPARK_CELL_COLUMNS];
+
+//! Number of samples in the rightmost character
+static uint8_t sparkFill;
+
+//! Character codes currently shown, per line of the widget
+static uint8_t sparkShadow[2][LCD_SPARK_MAX_CELLS];
+
+/*!
+ *  Places the widget on the display and removes all samples.
+ *
+ *  \param line    Top line of the widget (1 or 2).
+ *  \param column  Leftmost column of the widget (1...16).
+ *  \param cells   Width in characters (limited by the number of CGRAM slots).
+ *  \param lines   Height in lines (1 = 8 pixels, 2 = 16 pixels).
+ */
+void lcd_sparkInit(uint8_t line, uint8_t column, uint8_t cells, uint8_t lines) {
+    sparkLines = (lines == 2 && line == 1) ? 2 : 1;
+    sparkLine = line;
+    sparkColumn = column;
+
+    // Every character of the widget may need its own CGRAM slot
+    if (cells > LCD_GLYPH_SLOTS / sparkLines) {
+        cells = LCD_GLYPH_SLOTS / sparkLines;
+    }
+    if (cells > 17 - column) {
+        cells = 17 - column;
+    }
+    sparkCells = cells;
+
+    lcd_sparkClear();
+}
+
+/*!
+ *  Removes all samples. The characters are rewritten on the next draw.
+ */
+void lcd_sparkClear(void) {
+    uint8_t i;
+    for (i = 0; i < sizeof(sparkHeights); i++) {
+        sparkHeights[i] = LCD_SPARK_NONE;
+    }
+    for (i = 0; i < LCD_SPARK_MAX_CELLS; i++) {
+        sparkShadow[0][i] = LCD_SPARK_UNKNOWN;
+        sparkShadow[1][i] = LCD_SPARK_UNKNOWN;
+    }
+    // The first sample starts a new character
+    sparkFill = LCD_SPARK_CELL_COLUMNS;
+}
+
+/*!
+ *  Appends a sample. Call lcd_sparkDraw to show it.
+ *
+ *  \param sample      The sample.
+ *  \param upperBound  The largest possible sample (e.g. 1023 for the ADC).
+ */
+void lcd_sparkPush(uint16_t sample, uint16_t upperBound) {
+    uint8_t const columns = sparkCells * LCD_SPARK_CELL_COLUMNS;
+    uint8_t i;
+
+    if (!sparkCells) {
+        return;
+    }
+
+    // Rightmost character is full: move everything one character to the left
+    if (sparkFill == LCD_SPARK_CELL_COLUMNS) {
+        for (i = 0; i < columns - LCD_SPARK_CELL_COLUMNS; i++) {
+            sparkHeights[i] = sparkHeights[i + LCD_SPARK_CELL_COLUMNS];
+        }
+        for (; i < columns; i++) {
+            sparkHeights[i] = LCD_SPARK_NONE;
+        }
+        sparkFill = 0;
+    }
+
+    if (sample > upperBound) {
+        sample = upperBound;
+    }
+    sparkHeights[columns - LCD_SPARK_CELL_COLUMNS + sparkFill] =
+        (uint32_t)sample * (8 * sparkLines) / ((uint32_t)upperBound + 1);
+    sparkFill++;
+}
+
+/*!
+ *  Computes the pixel rows of one character of the widget.
+ *  \internal
+ *
+ *  \param row     Line within the widget (0 = top).
+ *  \param cell    Character within the line (0 = left).
+ *  \param dots    Receives the row of the dot (1 = top ... 8 = bottom, 0 = none)
+ *                 for each of the five pixel columns.
+ *  \return        Logical glyph ID or LCD_GLYPH_NONE for an empty character.
+ */
+static uint16_t lcd_sparkCell(uint8_t row, uint8_t cell, uint8_t *dots) {
+    uint8_t const *heights = &sparkHeights[cell * LCD_SPARK_CELL_COLUMNS];
+    uint8_t const bottom = (sparkLines - 1 - row) * 8; // Height of the lowest pixel row
+    uint16_t id = 0;
+    uint8_t i;
+
+    for (i = 0; i < LCD_SPARK_CELL_COLUMNS; i++) {
+        uint8_t const height = heights[i];
+        uint8_t dot = 0;
+        if (height != LCD_SPARK_NONE && height >= bottom && height < bottom + 8) {
+            dot = 8 - (height - bottom);
+        }
+        dots[i] = dot;
+        // The content fits into 9^5 = 59049 IDs
+        id = id * 9 + dot;
+    }
+
+    return id ? LCD_GLYPH_SPARK + id : LCD_GLYPH_NONE;
+}
+
+/*!
+ *  Updates the display. Characters that only moved use glyphs that are
+ *  already resident, so usually just the rightmost character is uploaded
+ *  to the CGRAM, and characters are only rewritten where their code changed.
+ */
+void lcd_sparkDraw(void) {
+    uint8_t codes[2][LCD_SPARK_MAX_CELLS];
+    uint8_t dots[LCD_SPARK_CELL_COLUMNS];
+    uint8_t row, cell;
+
+    // Touch all glyphs that are still resident first, so none of them is
+    // evicted by the uploads below
+    for (row = 0; row < sparkLines; row++) {
+        for (cell = 0; cell < sparkCells; cell++) {
+            uint16_t const id = lcd_sparkCell(row, cell, dots);
+            codes[row][cell] = (id == LCD_GLYPH_NONE) ? ' ' : lcd_glyphFind(id);
+        }
+    }
+
+    for (row = 0; row < sparkLines; row++) {
+        uint8_t cursor = LCD_SPARK_MAX_CELLS; // Character the LCD cursor points to
+
+        for (cell = 0; cell < sparkCells; cell++) {
+            uint8_t code = codes[row][cell];
+
+            if (code == LCD_GLYPH_MISS) {
+                uint16_t const id = lcd_sparkCell(row, cell, dots);
+                uint8_t pixels[8] = {0};
+                uint64_t bitmap = 0;
+                uint8_t i;
+
+                for (i = 0; i < LCD_SPARK_CELL_COLUMNS; i++) {
+                    if (dots[i]) {
+                        pixels[dots[i] - 1] |= 0x10 >> i;
+                    }
+                }
+                for (i = 8; i--;) {
+                    bitmap = (bitmap << 8) | pixels[i];
+                }
+                code = lcd_glyphStore(id, bitmap);
+            }
+
+            if (sparkShadow[row][cell] == code) {
+                continue;
+            }
+            if (cursor != cell) {
+                lcd_goto(sparkLine + row, sparkColumn + cell);
+            }
+            lcd_writeRawChar(code);
+            sparkShadow[row][cell] = code;
+            cursor = cell + 1;
+        }
+    }
+}
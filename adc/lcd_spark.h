@@ -0,0 +1,39 @@
+/*! \file
+ *  \brief Sparkline widget for the LCD.
+ *
+ *  Shows the most recent samples as a scrolling pixel waveform, one sample
+ *  per pixel column, either 8 pixels (one line) or 16 pixels (two lines)
+ *  tall. New samples are appended to the rightmost character. Once it is
+ *  full, the waveform moves one character to the left.
+ *
+ *  Every character is a custom char from the glyph cache, whose logical ID
+ *  is derived from its content. A character that merely moves to the left
+ *  therefore stays resident, and a new sample uploads one glyph per line.
+ *  As there are only eight CGRAM slots, the widget is at most eight
+ *  characters (one line) or four characters (two lines) wide.
+ */
+
+#ifndef _LCD_SPARK_H
+#define _LCD_SPARK_H
+
+#include <stdint.h>
+
+//! Pixel columns (i.e. samples) per character
+#define LCD_SPARK_CELL_COLUMNS 5
+
+//! Maximum number of characters per line
+#define LCD_SPARK_MAX_CELLS 8
+
+//! Places the widget at (line, column), cells characters wide and lines (1 or 2) tall
+void lcd_sparkInit(uint8_t line, uint8_t column, uint8_t cells, uint8_t lines);
+
+//! Removes all samples and forgets what has been drawn
+void lcd_sparkClear(void);
+
+//! Appends a sample in the range 0...upperBound (the display is not updated)
+void lcd_sparkPush(uint16_t sample, uint16_t upperBound);
+
+//! Updates the characters of the widget that have changed
+void lcd_sparkDraw(void);
+
+#endif
@@ -0,0 +1,149 @@
+#include "lcd_viewport.h"
+#include "lcd.h"
+
+#include <stdbool.h>
+#include <avr/pgmspace.h>
+
+/*! \file
+ *  Scrolling through the 40 DDRAM columns with the display shift command.
+ */
+
+//! Command to shift the display content to the left (window moves right)
+#define LCD_SHIFT_LEFT 0x18
+
+//! Command to shift the display content to the right (window moves left)
+#define LCD_SHIFT_RIGHT 0x1C
+
+//! First visible DDRAM column
+static uint8_t viewportOffset;
+
+/*!
+ *  Writes text into all DDRAM columns of a line.
+ *  \internal
+ *
+ *  \param line  The line (1 or 2).
+ *  \param text  The text (null terminated).
+ *  \param prog  Whether text is located in the program flash memory.
+ *  \return      The number of characters taken from text (at most 40).
+ */
+static uint8_t lcd_viewportFill(uint8_t line, char const *text, bool prog) {
+    uint8_t length = 0;
+    uint8_t column;
+
+    lcd_command(LCD_CURSOR_MOVE_R + ((line == 2) ? LCD_NEXT_ROW : 0));
+
+    for (column = 0; column < LCD_VIEWPORT_COLUMNS; column++) {
+        char c = ' ';
+        if (text) {
+            char const next = prog ? pgm_read_byte(text) : *text;
+            if (next) {
+                c = next;
+                text++;
+                length++;
+            } else {
+                text = NULL;
+            }
+        }
+        lcd_writeRawChar(c);
+    }
+
+    // Keep the character counter of the driver consistent
+    lcd_goto(line, 1);
+    return length;
+}
+
+/*!
+ *  Writes ASCII text into all 40 DDRAM columns of a line. The remaining
+ *  columns are filled with spaces, longer text is cut off.
+ *
+ *  \param line  The line (1 or 2).
+ *  \param text  The text (null terminated).
+ *  \return      The length of the written text.
+ */
+uint8_t lcd_viewportWrite(uint8_t line, char const *text) {
+    return lcd_viewportFill(line, text, false);
+}
+
+/*!
+ *  Writes ASCII text from the program flash memory into all 40 DDRAM
+ *  columns of a line. See lcd_viewportWrite.
+ *
+ *  \param line  The line (1 or 2).
+ *  \param text  The text (null terminated) in the program flash memory.
+ *  \return      The length of the written text.
+ */
+uint8_t lcd_viewportWriteProg(uint8_t line, char const *text) {
+    return lcd_viewportFill(line, text, true);
+}
+
+/*!
+ *  Moves the visible window. The window wraps around after 40 columns.
+ *  Every step costs one command.
+ *
+ *  \param steps  Columns to move (positive = window moves right).
+ */
+void lcd_viewportScroll(int8_t steps) {
+    while (steps > 0) {
+        lcd_command(LCD_SHIFT_LEFT);
+        viewportOffset = (viewportOffset + 1) % LCD_VIEWPORT_COLUMNS;
+        steps--;
+    }
+    while (steps < 0) {
+        lcd_command(LCD_SHIFT_RIGHT);
+        viewportOffset = (viewportOffset + LCD_VIEWPORT_COLUMNS - 1) % LCD_VIEWPORT_COLUMNS;
+        steps++;
+    }
+}
+
+/*!
+ *  Moves the visible window to a column, shifting in whichever direction
+ *  needs fewer commands (at most 20).
+ *
+ *  \param offset  The new first visible column (0...39).
+ */
+void lcd_viewportSet(uint8_t offset) {
+    uint8_t const forward = (offset % LCD_VIEWPORT_COLUMNS + LCD_VIEWPORT_COLUMNS - viewportOffset) % LCD_VIEWPORT_COLUMNS;
+
+    if (forward <= LCD_VIEWPORT_COLUMNS / 2) {
+        lcd_viewportScroll(forward);
+    } else {
+        lcd_viewportScroll(-(int8_t)(LCD_VIEWPORT_COLUMNS - forward));
+    }
+}
+
+/*!
+ *  \return The first visible DDRAM column (0...39).
+ */
+uint8_t lcd_viewportOffset(void) {
+    return viewportOffset;
+}
+
+/*!
+ *  Moves the visible window back to column 0, so the display can be used
+ *  with lcd_goto and lcd_writeChar again. Unlike lcd_clear, the content is
+ *  preserved.
+ */
+void lcd_viewportHome(void) {
+    lcd_viewportSet(0);
+}
+
+/*!
+ *  Notes that the controller has reset the display shift (e.g. by the clear
+ *  command). Called by lcd_clear.
+ */
+void lcd_viewportReset(void) {
+    viewportOffset = 0;
+}
+
+/*!
+ *  Advances a marquee by one column. The text written with
+ *  lcd_viewportWrite runs through the window and comes back around after
+ *  40 steps. Text that fits into the visible columns is not moved.
+ *
+ *  \param length  Length of the text as returned by lcd_viewportWrite.
+ */
+void lcd_viewportMarquee(uint8_t length) {
+    if (length > LCD_VIEWPORT_VISIBLE) {
+        lcd_viewportScroll(1);
+    }
+}
@@ -0,0 +1,51 @@
+/*! \file
+ *  \brief Hardware scrolled viewport of the LCD.
+ *
+ *  The LCD controller holds 40 characters per line in its DDRAM, of which
+ *  16 are visible. Text for the viewport is written once into all 40
+ *  columns of a line and then scrolled with the display shift command,
+ *  which costs one command per step instead of rewriting 16 characters.
+ *
+ *  Note that the controller always shifts both lines together. The other
+ *  line should either be written through the viewport as well or be empty.
+ *  While the viewport is shifted, the columns used by lcd_goto and
+ *  lcd_writeChar are not the visible ones; call lcd_viewportHome before
+ *  using them again (lcd_clear does this as well).
+ */
+
+#ifndef _LCD_VIEWPORT_H
+#define _LCD_VIEWPORT_H
+
+#include <stdint.h>
+
+//! Columns per line in the DDRAM of the LCD controller
+#define LCD_VIEWPORT_COLUMNS 40
+
+//! Visible columns per line
+#define LCD_VIEWPORT_VISIBLE 16
+
+//! Writes ASCII text into all 40 columns of the line (1 or 2), padded with spaces
+uint8_t lcd_viewportWrite(uint8_t line, char const *text);
+
+//! Writes ASCII text from PROGMEM into all 40 columns of the line (1 or 2)
+uint8_t lcd_viewportWriteProg(uint8_t line, char const *text);
+
+//! Moves the visible window by steps columns (positive = to the right)
+void lcd_viewportScroll(int8_t steps);
+
+//! Moves the visible window to the passed column with the fewest shift commands
+void lcd_viewportSet(uint8_t offset);
+
+//! Returns the first visible column
+uint8_t lcd_viewportOffset(void);
+
+//! Moves the visible window back to column 0
+void lcd_viewportHome(void);
+
+//! Advances a marquee of the passed text length by one step
+void lcd_viewportMarquee(uint8_t length);
+
+//! Notes that the controller has reset the shift (called by lcd_clear)
+void lcd_viewportReset(void);
+
+#endif
@@ -1,32 +1,260 @@
 #include "led.h"
+#include "timebase.h"
+
+#include <stdbool.h>
 #include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
+
+/*! \file
+ *  Double buffered LED bar with level modes and software PWM.
+ */
 
 uint16_t activateLedMask = 0xFFFF;
+uint16_t reservedLedMask;
+
+//! States of both ports (low active, only the active LEDs)
+typedef struct {
+    uint8_t portD; //!< LEDs 8...15
+    uint8_t portA; //!< LEDs 0...7
+} LedFrame;
+
+//! Front buffer (shown) and back buffer (composed)
+static LedFrame ledFrames[2];
+
+//! Index of the front buffer
+static volatile uint8_t ledFront;
+
+//! Active LEDs of both ports, as set by initLedBar
+static uint8_t ledMaskD, ledMaskA;
+
+//! Lowest active LED and number of active LEDs (the active LEDs are one block)
+static uint8_t ledFirst, ledCount;
+
+//! Selected LED_MODE_*
+static uint8_t ledMode;
+
+//! Brightness (0...LED_PWM_STEPS) and position in the PWM period
+static volatile uint8_t ledBrightness = LED_PWM_STEPS;
+static uint8_t ledPhase;
+
+//! Number of LEDs of the peak and time it was reached or last fell
+static uint8_t ledPeak;
+static uint32_t ledPeakTime;
+
+//! Bars of 0...16 LEDs
+static const uint16_t ledBars[17] PROGMEM = {
+    0x0000, 0x0001, 0x0003, 0x0007, 0x000F, 0x001F, 0x003F, 0x007F, 0x00FF,
+    0x01FF, 0x03FF, 0x07FF, 0x0FFF, 0x1FFF, 0x3FFF, 0x7FFF, 0xFFFF
+};
+
+//! Logarithmic scale: 255 * (1 + 20 * log10(value / 1023) / 48) for value >> 3
+static const uint8_t ledLogLevels[128] PROGMEM = {
+      0,  50,  74,  89, 101, 110, 118, 124, 130, 135, 140, 144, 148, 151, 155, 158,
+    161, 163, 166, 168, 171, 173, 175, 177, 179, 181, 183, 184, 186, 187, 189, 190,
+    192, 193, 195, 196, 197, 199, 200, 201, 202, 203, 204, 205, 206, 207, 208, 209,
+    210, 211, 212, 213, 214, 215, 216, 217, 217, 218, 219, 220, 221, 221, 222, 223,
+    224, 224, 225, 226, 226, 227, 228, 228, 229, 230, 230, 231, 231, 232, 233, 233,
+    234, 234, 235, 235, 236, 237, 237, 238, 238, 239, 239, 240, 240, 241, 241, 242,
+    242, 243, 243, 244, 244, 244, 245, 245, 246, 246, 247, 247, 248, 248, 248, 249,
+    249, 250, 250, 250, 251, 251, 252, 252, 252, 253, 253, 254, 254, 254, 255, 255
+};
+
+/*!
+ *  Writes the front buffer to the ports, leaving the pins of inactive LEDs
+ *  as they are. Interrupts have to be disabled.
+ *
+ *  \param on  False to switch all active LEDs off (PWM off phase).
+ */
+static void writeLedPorts(bool on) {
+    LedFrame const *const frame = &ledFrames[ledFront];
+    uint8_t const portD = (PORTD & ~ledMaskD) | (on ? frame->portD : ledMaskD);
+    uint8_t const portA = (PORTA & ~ledMaskA) | (on ? frame->portA : ledMaskA);
+
+    PORTD = portD;
+    PORTA = portA;
+}
 
 /*!
- *  Initializes the led bar. Note: All PORTs will be set to output.
+ *  Initializes the led bar. Only the pins of the LEDs in activateLedMask
+ *  are set to output, and those LEDs are switched off. Pins of LEDs that
+ *  were active before but are not any more become inputs without pull-up.
+ *  Reserved LEDs are neither used nor released.
  */
 void initLedBar(void) {
-    // Configure Port A and Port D for LED output
-    DDRA = 255;   // Set all Port A pins as output
-    PORTA = 255;  // Turn all Port A LEDs off initially (1 = off)
+    uint16_t mask = activateLedMask & ~reservedLedMask;
+    uint8_t const releasedD = ledMaskD & ~(mask >> 8) & ~(reservedLedMask >> 8);
+    uint8_t const releasedA = ledMaskA & ~mask & ~reservedLedMask;
+
+    ledMaskD = mask >> 8;
+    ledMaskA = mask;
+
+    // The active LEDs are expected to be one block
+    ledFirst = 0;
+    ledCount = 0;
+    if (mask) {
+        while (!(mask & 1)) {
+            mask >>= 1;
+            ledFirst++;
+        }
+        while (mask & 1) {
+            mask >>= 1;
+            ledCount++;
+        }
+    }
+
+    ledMode = LED_MODE_LINEAR;
+    ledPeak = 0;
 
-    DDRD = 255;   // Set all Port D pins as output
-    PORTD = 255;  // Turn all Port D LEDs off initially (1 = off)
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        ledFrames[ledFront].portD = ledMaskD;
+        ledFrames[ledFront].portA = ledMaskA;
+
+        // Configure Port A and Port D for LED output
+        DDRD = (DDRD & ~releasedD) | ledMaskD;
+        DDRA = (DDRA & ~releasedA) | ledMaskA;
+        PORTD &= ~releasedD;
+        PORTA &= ~releasedA;
+        writeLedPorts(true);  // 1 = off
+    }
 }
 
 /*!
  *  Sets the passed value as states of the LED bar (0 = on, 1 = off).
+ *  Bits of inactive LEDs are ignored.
  */
 void setLedBar(uint16_t value) {
-    PORTD = 255;  // Default all LEDs on Port D to off
-    PORTA = 255;  // Default all LEDs on Port A to off
+    uint8_t const back = ledFront ^ 1;
 
     // Map the 16-bit 'value' to corresponding ports:
     // High byte (hhhhmmmm) → PORTD
     // Low byte (mmssssss)  → PORTA
-    PORTD = (value >> 8); // Send high 8 bits to PORTD
-    PORTA = value;        // Send low 8 bits to PORTA
+    ledFrames[back].portD = (value >> 8) & ledMaskD;
+    ledFrames[back].portA = value & ledMaskA;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        ledFront = back;
+
+        // During the off phase of the PWM the next period shows the frame
+        if (ledPhase < ledBrightness) {
+            writeLedPorts(true);
+        }
+    }
 }
 
+/*!
+ *  Selects how setLedLevel shows a level.
+ *
+ *  \param mode  LED_MODE_LINEAR or LED_MODE_LOG, optionally | LED_MODE_PEAK.
+ */
+void setLedMode(uint8_t mode) {
+    ledMode = mode;
+    ledPeak = 0;
+}
 
+/*!
+ *  Shows a level as bar on the active LEDs, starting at the lowest one.
+ *  In linear mode every 1024 / (active LEDs + 1) add one LED, so the full
+ *  bar needs the maximum value. With LED_MODE_PEAK the highest recent
+ *  level stays lit for LED_PEAK_HOLD_MS and then falls by one LED every
+ *  LED_PEAK_FALL_MS.
+ *
+ *  \param value  Level from 0 to 1023.
+ */
+void setLedLevel(uint16_t value) {
+    uint8_t count;
+    uint16_t bar;
+
+    if (value > 1023) {
+        value = 1023;
+    }
+
+    if (ledMode & LED_MODE_LOG) {
+        count = ((uint16_t)pgm_read_byte(&ledLogLevels[value >> 3]) * (ledCount + 1)) >> 8;
+    } else {
+        count = (value * (ledCount + 1)) >> 10;
+    }
+    bar = pgm_read_word(&ledBars[count]);
+
+    if (ledMode & LED_MODE_PEAK) {
+        uint32_t const now = timebase_millis();
+
+        if (count >= ledPeak) {
+            ledPeak = count;
+            ledPeakTime = now + LED_PEAK_HOLD_MS - LED_PEAK_FALL_MS;
+        } else if ((int32_t)(now - ledPeakTime) >= LED_PEAK_FALL_MS) {
+            ledPeak--;
+            ledPeakTime = now;
+        }
+
+        // The single LED of the peak
+        if (ledPeak) {
+            bar |= pgm_read_word(&ledBars[ledPeak]) ^ pgm_read_word(&ledBars[ledPeak - 1]);
+        }
+    }
+
+    setLedBar(~(bar << ledFirst));
+}
+
+/*!
+ *  Shows a bar like setLedLevel, but with a peak that the caller keeps
+ *  (e.g. a level meter with its own hold time).
+ *
+ *  \param level  Length of the bar, 255 lights all active LEDs.
+ *  \param peak   Position of the single peak LED on the same scale, below
+ *                one LED nothing is shown.
+ */
+void setLedMeter(uint8_t level, uint8_t peak) {
+    uint8_t const count = ((uint16_t)level * (ledCount + 1)) >> 8;
+    uint8_t const peakCount = ((uint16_t)peak * (ledCount + 1)) >> 8;
+    uint16_t bar = pgm_read_word(&ledBars[count]);
+
+    if (peakCount) {
+        bar |= pgm_read_word(&ledBars[peakCount]) ^ pgm_read_word(&ledBars[peakCount - 1]);
+    }
+
+    setLedBar(~(bar << ledFirst));
+}
+
+/*!
+ *  Sets the brightness of the LEDs.
+ *
+ *  \param brightness  0 (off) ... LED_PWM_STEPS (always on).
+ */
+void setLedBrightness(uint8_t brightness) {
+    if (brightness > LED_PWM_STEPS) {
+        brightness = LED_PWM_STEPS;
+    }
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        ledBrightness = brightness;
+
+        // The PWM does not touch the ports at full brightness
+        if (brightness == LED_PWM_STEPS) {
+            writeLedPorts(true);
+        }
+    }
+}
+
+/*!
+ *  Software PWM of the LEDs, called by the timebase ISR every tick. The
+ *  ports are only written at the start of the period and at the end of the
+ *  duty cycle; at full brightness they are not touched at all.
+ */
+void tickLedBar(void) {
+    uint8_t const brightness = ledBrightness;
+
+    if (++ledPhase >= LED_PWM_STEPS) {
+        ledPhase = 0;
+    }
+
+    if (brightness == LED_PWM_STEPS) {
+        return;
+    }
+
+    if (ledPhase == 0 && brightness) {
+        writeLedPorts(true);
+    } else if (ledPhase == brightness) {
+        writeLedPorts(false);
+    }
+}
@@ -2,6 +2,23 @@
  *  \brief LED bar module.
  *  Contains functionality to access the LEDs of the evaluation board.
  *
+ *  The LEDs are low active: the high byte of a value goes to PORTD, the low
+ *  byte to PORTA. Only the LEDs in activateLedMask are driven, the other pins
+ *  (e.g. PA0, the ADC input) are left alone. A frame is composed in a back
+ *  buffer and both ports are written right after each other with interrupts
+ *  disabled, so no intermediate state is ever visible.
+ *
+ *  Levels are mapped to bars without division or loops: the number of LEDs
+ *  comes from a multiplication and a shift (linear) or a table (logarithmic),
+ *  the bar pattern from a table in the flash.
+ *
+ *  The brightness is set by a software PWM running on the tick of the
+ *  timebase with LED_PWM_STEPS steps (250Hz at 4 steps). Its cost is fixed:
+ *  tickLedBar only switches all LEDs on at the start of the period and off
+ *  at the end of the duty cycle. Estimated from the generated code, that is
+ *  about 40 cycles (2us at 20MHz) in the two ticks of a period in which the
+ *  ports are written and about 15 cycles in the others, including the call.
+ *
  *  \author   Lehrstuhl fE Informatik 11 - RWTH Aachen
  *  \date     2013
  *  \version  1.0
@@ -12,13 +29,49 @@
 
 #include <stdint.h>
 
-//! Mask for activating/deactivating LEDs on the bar
+//! Level shown as number of LEDs proportional to the value
+#define LED_MODE_LINEAR 0x00
+
+//! Level shown on a logarithmic scale (48dB over the whole bar)
+#define LED_MODE_LOG 0x01
+
+//! Or'ed with a mode: the highest recent level stays visible as a single LED
+#define LED_MODE_PEAK 0x80
+
+//! Milliseconds the peak is held before it falls
+#define LED_PEAK_HOLD_MS 1000
+
+//! Milliseconds per LED while the peak falls
+#define LED_PEAK_FALL_MS 100
+
+//! Brightness levels of the software PWM (LED_PWM_STEPS = full brightness)
+#define LED_PWM_STEPS 4
+
+//! Mask for activating/deactivating LEDs on the bar (1 = used), read by initLedBar
 extern uint16_t activateLedMask;
 
-//! Initializes the led bar. Note: All PORTs will be set to output.
+//! LEDs that other modules drive directly (e.g. the alarm), never used or released by the bar
+extern uint16_t reservedLedMask;
+
+//! Initializes the led bar. Note: Only the pins of the LEDs in activateLedMask (except the reserved ones) will be set to output.
 void initLedBar(void);
 
-//! Sets the passed value as states of the led bar (1 = on, 0 = off).
+//! Sets the passed value as states of the led bar (0 = on, 1 = off).
 void setLedBar(uint16_t value);
 
+//! Selects how setLedLevel shows a level (LED_MODE_*)
+void setLedMode(uint8_t mode);
+
+//! Shows a 10 bit value (e.g. an ADC result) as level on the active LEDs
+void setLedLevel(uint16_t value);
+
+//! Shows a bar and a single peak LED, both as fraction of the active LEDs (0...255)
+void setLedMeter(uint8_t level, uint8_t peak);
+
+//! Sets the brightness (0 = off ... LED_PWM_STEPS = full)
+void setLedBrightness(uint8_t brightness);
+
+//! Advances the software PWM, called by the timebase ISR every tick
+void tickLedBar(void);
+
 #endif
@@ -6,17 +6,14 @@
  *  \version  1.0
  */
 
-#include "lcd.h"
-#include "os_input.h"
+#include "init.h"
 #include "menu.h"
 
 int main(void) {
-    // 1. Initialize the buttons
-    os_initInput();
+    // 1. Initialize all modules, the LCD last so that its power-up time
+    //    overlaps the others
+    init_require(INIT_ALL);
 
-    // 2. Initialize LCD
-    lcd_init();
-
-    // 3. Show menu
+    // 2. Show menu
     showMenu();
 }
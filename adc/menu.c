@@ -1,167 +1,197 @@
 #include "menu.h"
 #include "os_input.h"
+#include "os_event.h"
 #include "bin_clock.h"
 #include "lcd.h"
+#include "lcd_bar.h"
+#include "lcd_spark.h"
+#include "lcd_viewport.h"
 #include "led.h"
+#include "meter.h"
+#include "rate.h"
 #include "adc.h"
+#include "alarm.h"
+#include "capture.h"
+#include "goertzel.h"
+#include "init.h"
+#include "latency.h"
+#include "scheduler.h"
+#include "stats.h"
+#include "supply.h"
+#include "timebase.h"
+#include <stdbool.h>
 #include <stdint.h>
 #include <avr/io.h>
-#include <util/delay.h>
+#include <avr/pgmspace.h>
 #include <string.h>
+#include <util/atomic.h>
 
+//! Value of runningProgram while the menu is shown
+#define NO_PROGRAM 0xFF
 
-/*!
- *  Hello world program.
- *  Shows the string 'Hello World!' on the display.
- */
+//! Milliseconds per step of a menu entry that is wider than the display
+#define MENU_MARQUEE_MS 300
+
+//! Number of pages of the diagnostics
+#define DIAGNOSTICS_PAGES 4
+
+//! Number of pages of the statistics
+#define STATISTICS_PAGES 5
+
+//! Number of filter presets, see applyFilterPreset
+#define FILTER_PRESETS 7
+
+//! Filter preset that is used from the start
+#define FILTER_DEFAULT_PRESET 2
+
+//! Program of the menu, see menuEntries
+typedef struct {
+    const char *label;              //!< Name in the flash
+    void (*start)(void);            //!< Prepares the program and its screen, may be NULL
+    Task background;                //!< Refreshes the screen periodically, may be NULL
+    uint16_t period;                //!< Milliseconds between runs of background
+    void (*button)(uint8_t button); //!< Handles presses except ESC, may be NULL
+    void (*leave)(void);            //!< Cleans up when ESC returns to the menu, may be NULL
+} MenuEntry;
 
 //! Global variables
-uint16_t miliseconds;
-uint8_t sec;
-uint8_t minute;
-uint8_t hour;
+ClockTime currentTime;
 uint16_t combinedTime;
 
-uint8_t isEscPressed(void) {
-    return (os_getInput() == 0b00001000);
-}
+//! Index of the running program or NO_PROGRAM
+uint8_t runningProgram = NO_PROGRAM;
 
-void lcd_writePaddedDec(uint8_t value, uint8_t minDigits) {
-	if (value < 10 && minDigits >= 2) {
-		lcd_writeDec(0);
-	}
-	lcd_writeDec(value);
-}
+//! Menu entry that is shown
+uint8_t pageIndex;
 
-void lcd_writePaddedMilisec(uint8_t value) {
-	if (value < 100) {
-		lcd_writeDec(0); // e.g. 050
-	}
-	lcd_writeDec(value);
-}
+//! Timer of the running program that refreshes the display
+uint8_t refreshTimer = SCHED_NO_TIMER;
 
-void updateTime() {
-	sec = getSeconds();
-	minute = getMinutes();
-	hour = getHours();
-	miliseconds = getMilliseconds();
-}
+//! Length of the menu entry in the viewport, see menuMarquee
+uint8_t menuEntryLength;
 
-void writePaddedDec(uint16_t value, uint8_t width) {
-	if (value < 10 && width >= 3) {
-		lcd_writeProgString(PSTR("00"));
-	} else if (value < 100 && width >= 3) {
-		lcd_writeProgString(PSTR("0"));
-	}
-	lcd_writeDec(value);
-}
+//! Latest ADC value of the sampling task
+uint16_t lastSample;
 
-// Computes the LED display value based on ADC result
-// - Each LED lights up for every 68 ADC units
-// - The first LED lights up at ADC value >= 68
-// - Each subsequent LED lights up for every 68 units of ADC value
-// - Maximum ADC value (1023) lights up all 16 LEDs
-// - The result is a 16-bit value where each bit represents an LED (0 = off, 1 = on)
+//! Index of the stored voltage shown by the ADC program
+uint8_t SpeicherCounter;
 
-uint16_t computeLedValue(uint16_t adcResult) {
-	uint16_t ledValue = 0;
-	while (adcResult >= 68) {
-		ledValue = (ledValue << 1) | 0x0002;
-		adcResult -= 68;
-	}
-	return ~ledValue;
+//! Whether the hello world program currently shows its text
+bool helloVisible;
+
+//! Microseconds from the last button edge until its event was handled (incl. display)
+uint32_t inputLatency;
+
+//! Largest inputLatency since the start
+uint32_t maxInputLatency;
+
+//! Page shown by the diagnostics
+uint8_t diagnosticsPage;
+
+//! Statistics of all samples since the last reset and of the recent ones
+Stats adcTotal, adcRecent;
+
+//! Page shown by the statistics
+uint8_t statisticsPage;
+
+//! Filter preset of the ADC
+uint8_t filterPreset;
+
+//! Sample of the capture shown by the scope
+uint8_t scopeIndex;
+
+//! Bin of the tone detector in the first line
+uint8_t tonesBin;
+
+//! Event of the alarm log that is shown (0 = newest)
+uint8_t alarmAge;
+
+//! Recorded voltage shown by the recorder
+uint8_t recorderIndex;
+
+void updateTime() {
+	// One consistent snapshot, the ISR may advance the clock at any time
+	getTime(&currentTime);
 }
 
 void updateSpeicherCounter(uint8_t *counter, uint8_t input) {
-	if (input == 0b00000100) { // UP
+	if (input == OS_BUTTON_UP) { // UP
 		*counter = (*counter != 100) ? (*counter + 1) : 0;
-	} else if (input == 0b00000010) { // DOWN
+	} else if (input == OS_BUTTON_DOWN) { // DOWN
 		*counter = (*counter != 0) ? (*counter - 1) : 100;
 	}
 }
 
 void checkAndStoreVoltage(uint8_t input) {
-    if (input == 0b00000001) { // If ENTER button (0b00000001) is pressed
+    if (input == OS_BUTTON_ENTER) { // If ENTER button (0b00000001) is pressed
         storeVoltage(); // Store the current voltage
     }
 }
 
 
+/*!
+ *  Hello world program (runs every 500ms).
+ *  Shows the string 'Hello World!' on the display and hides it again.
+ */
 void helloWorld(void) {
-	// Repeat until ESC gets pressed
-	lcd_init();
-	lcd_clear();
-
-	while(!isEscPressed()) { //solange ESC nicht gedruckt, wiederholen
+	helloVisible = !helloVisible;
+	if (helloVisible) {
 		lcd_writeProgString(PSTR("HELLO WORLD!"));
-		_delay_ms(500);
+	} else {
 		lcd_clear();
-		if (isEscPressed()) {
-			break;
-		}
-		_delay_ms(500);
 	}
-	
 }
 
 /*!
- *  Shows the clock on the display and a binary clock on the led bar.
+ *  Shows the clock on the display and a binary clock on the led bar
+ *  (runs every 10ms).
  */
 void displayClock(void) {
-	while(!isEscPressed()) { //solange ESC nicht gedruckt, wiederholen
-	
-		updateTime();
-		
-		// Update the combined time for the binary clock on the LED bar
-
-		// Shift and combine the hour value into the higher bits of combinedTime
-		combinedTime = (combinedTime | hour) << 6;  // Add hour to the leftmost bits (hour << 6)
-
-		// Shift and combine the minute value into the next bits of combinedTime
-		combinedTime = (combinedTime | minute) << 6;  // Add minute after shifting the previous hour data
+	updateTime();
 
-		// Combine the second value into the least significant bits of combinedTime
-		combinedTime = (combinedTime | sec);  // Add seconds to the least significant bits
+	// Update the combined time for the binary clock on the LED bar
 
-		// Display the final combined time (in binary) on the LED bar (invert bits for correct display)
-		setLedBar(~combinedTime);  // Invert combinedTime to match the LED bar logic
+	// hhhhmmmm mmssssss: hour in the upper 4 bits, then minute and second with 6 bits each
+	combinedTime = ((uint16_t)currentTime.hours << 12) | ((uint16_t)currentTime.minutes << 6) | currentTime.seconds;
 
-		    
-		lcd_clear();
-		lcd_writePaddedDec(hour, 2);
-		lcd_writeChar(':');
-		lcd_writePaddedDec(minute, 2);
-		lcd_writeChar(':');
-		lcd_writePaddedDec(sec, 2);
-		lcd_writeChar(':');
-		lcd_writePaddedMilisec(milisec);
-			
-		    
-		    
-		// Pro 10milisec wird Zeit erneuert
-		// Also am besten vllt sollen wir 10 milisec warten
-		    
-		_delay_ms(10);
-		    
-	
-	}
+	// Display the final combined time (in binary) on the LED bar (invert bits for correct display)
+	setLedBar(~combinedTime);  // Invert combinedTime to match the LED bar logic
 
+	// The BCD counters are written digit by digit, no division needed
+	// The text has a fixed width, so it is simply overwritten
+	lcd_line1();
+	lcd_writeBcd(currentTime.bcdHours);
+	lcd_writeChar(':');
+	lcd_writeBcd(currentTime.bcdMinutes);
+	lcd_writeChar(':');
+	lcd_writeBcd(currentTime.bcdSeconds);
+	lcd_writeChar(':');
+	lcd_writeBcd(currentTime.bcdCentiseconds);
+	lcd_writeChar('0');
 }
 
-
-
 /*!
- *  Shows the stored voltage values in the second line of the display.
+ *  Shows the stored voltage values with the time they were taken (after
+ *  the first one) in the second line of the display.
  */
 void displayVoltageBuffer(uint8_t displayIndex) {
+	uint32_t const ms = getStoredTime(displayIndex) / 1000;
+
 	lcd_line2();
 	
 	// Write padded displayIndex like "007", "045", etc.
-	writePaddedDec(displayIndex, 3);
+	lcd_writePaddedDec(displayIndex, 3);
 
-	lcd_writeProgString(PSTR("/100: "));
-	uint16_t adcResult = getStoredVoltage(displayIndex);
-	lcd_writeVoltage(adcResult, 1023, 5);
+	// Tenths of a second up to 99.9s, then seconds
+	if (ms < 100000) {
+		lcd_printf_P(PSTR(" %4.1lks "), ms / 100);
+	} else {
+		lcd_printf_P(PSTR(" %4lus "), ms / 1000);
+	}
+	uint16_t sample = getStoredSample(displayIndex);
+	uint8_t range = ADC_SAMPLE_RANGE(sample);
+	// Stored AVCC samples are already referred to 5V
+	lcd_writeVoltage(ADC_SAMPLE_CODE(sample), (range == ADC_RANGE_AVCC) ? 1023 : getAdcRangeBound(range), 5);
 
 }
 
@@ -175,109 +205,991 @@ void displayVoltageLabel(void) {
 	lcd_writeProgString(PSTR("Voltage: ")); // Display the label "Voltage: "
 }
 
+/*!
+ *  Shows the ADC value on the display and on the led bar (runs every 100ms).
+ *  The label is written by start, only the values are overwritten.
+ */
 void displayAdc(void) {
-	uint8_t SpeicherCounter =0;
-	while (!isEscPressed()) { // Loop until ESC is pressed
+	uint16_t adcResult = lastSample; // Latest value of the sampling task
+
+	lcd_goto(1, 10); // Behind "Voltage: "
+	lcd_writeVoltage(adcResult, 1023, 5); // Display voltage (scaled to 5V, 10-bit resolution)
+
+	// Display the value as level on the LED bar
+	setLedLevel(adcResult);
+
+	// Check if ENTER button is held, then store voltage
+	// The first stored value replaces the level meter by the buffer view
+	uint8_t const buttons = os_getButtons();
+	if (getBufferSize() == 0 && buttons == OS_BUTTON_ENTER) {
+		lcd_erase(2);
+	}
+	checkAndStoreVoltage(buttons);
+
+	// If buffer is allocated, show stored voltage at current index
+	// Otherwise show the voltage as level meter (0...1023 -> 0...80 steps)
+	if (getBufferSize() != 0) {
+		displayVoltageBuffer(SpeicherCounter);
+	} else {
+		lcd_barDraw(2, (adcResult * 5 + 5) >> 6);
+	}
+}
+
+/*!
+ *  Shows the ADC value as scrolling waveform in the first line of the display
+ *  and as voltage in the second line (runs every 20ms, like the sampling
+ *  task).
+ */
+void displayWaveform(void) {
+	lcd_sparkPush(lastSample, 1023);
+
+	// Only the characters that changed are sent to the display
+	lcd_sparkDraw();
+
+	lcd_goto(2, 1);
+	lcd_writeVoltage(lastSample, 1023, 5);
+}
+
+/*!
+ *  Prepares the waveform and fills it with the most recent stored voltages.
+ */
+void startWaveform(void) {
+	uint8_t const visible = LCD_SPARK_MAX_CELLS * LCD_SPARK_CELL_COLUMNS;
+	uint8_t i = getBufferIndex();
+
+	init_require(INIT_ADC);
+	lcd_clear();
+	lcd_sparkInit(1, 1, LCD_SPARK_MAX_CELLS, 1);
+
+	for (i = (i > visible) ? i - visible : 0; i < getBufferIndex(); i++) {
+		lcd_sparkPush(getStoredVoltage(i), 1023);
+	}
+}
+
+/*!
+ *  Sampling task (runs every 20ms, also while the menu is shown). Takes the
+ *  latest filtered value of the ADC ISR, which samples much faster. The
+ *  statistics get every sample from onSample instead.
+ */
+void sampleAdc(void) {
+	lastSample = getAdcValue();
+}
+
+/*!
+ *  Prepares the hello world program.
+ */
+void startHelloWorld(void) {
+	init_require(INIT_LCD);
+	lcd_clear();
+	helloVisible = false;
+}
+
+/*!
+ *  Prepares the binary clock. It needs all 16 LEDs, so the ADC is paused
+ *  while it runs: LED 0 is PA0, the input of the ADC.
+ */
+void startClock(void) {
+	setAdcPaused(true);
+	activateLedMask = 0xFFFF;
+	initLedBar();
+	lcd_clear();
+}
+
+/*!
+ *  Releases LED 0 and resumes the ADC.
+ */
+void leaveClock(void) {
+	activateLedMask = 0xFFFE; // Don't use LED 0
+	initLedBar();
+	setAdcPaused(false);
+}
+
+/*!
+ *  Prepares the ADC program.
+ */
+void startAdc(void) {
+	activateLedMask = 0xFFFE; // Don't use LED 0
+	initLedBar();
+	setLedMode(LED_MODE_LINEAR | LED_MODE_PEAK);
+	init_require(INIT_ADC);
+	SpeicherCounter = 0;
+	displayVoltageLabel(); // Display "Voltage: " on the screen
+	lcd_barInit();
+}
+
+/*!
+ *  Shows the diagnostic values of the current page (runs every 500ms).
+ *  The values have a fixed width and are simply overwritten.
+ */
+void displayDiagnostics(void) {
+	lcd_line1();
+	switch (diagnosticsPage) {
+		case 0:
+			lcd_printf_P(PSTR("Boot: %7lu us"), init_bootTime());
+			lcd_line2();
+			lcd_printf_P(PSTR("Input: %6lu us"), maxInputLatency);
+			break;
+		case 1:
+			lcd_printf_P(PSTR("IRQ off:%5u us"), LATENCY_TO_US(latencyMaxIrqOff));
+			lcd_line2();
+			lcd_printf_P(PSTR("ISR:    %5u us"), LATENCY_TO_US(latencyMaxIsr));
+			break;
+		case 2:
+			lcd_printf_P(PSTR("AVCC:    %4u mV"), getAdcSupply());
+			lcd_line2();
+			lcd_printf_P(PSTR("Every:  %5u ms"), supply_interval());
+			break;
+		default:
+			lcd_printf_P(PSTR("Entry:  %5u us"), LATENCY_TO_US(latencyMaxEntry));
+			lcd_line2();
+			lcd_writeProgString(PSTR("ENTER: reset"));
+			break;
+	}
+}
+
+/*!
+ *  Shows the boot time and the latencies.
+ */
+void startDiagnostics(void) {
+	diagnosticsPage = 0;
+	lcd_clear();
+}
+
+/*!
+ *  Buttons of the diagnostics: UP/DOWN change the page, ENTER clears the
+ *  high-water marks.
+ */
+void buttonDiagnostics(uint8_t button) {
+	if (button == OS_BUTTON_ENTER) {
+		maxInputLatency = 0;
+		latency_reset();
+	} else if (button == OS_BUTTON_UP) {
+		diagnosticsPage = (diagnosticsPage != DIAGNOSTICS_PAGES - 1) ? (diagnosticsPage + 1) : 0;
+	} else if (button == OS_BUTTON_DOWN) {
+		diagnosticsPage = (diagnosticsPage != 0) ? (diagnosticsPage - 1) : DIAGNOSTICS_PAGES - 1;
+	} else {
+		return;
+	}
+
+	lcd_clear();
+	displayDiagnostics();
+}
+
+/*!
+ *  Writes a statistic value as voltage (scaled to 5V, 10-bit resolution).
+ *
+ *  \param value  The value.
+ *  \param scale  Value that corresponds to 1023 (1023 << fractional bits).
+ */
+void writeStatisticVoltage(uint32_t value, uint32_t scale) {
+	lcd_writeFixed(value * 5000 / scale, 3);
+	lcd_writeChar('V');
+}
+
+/*!
+ *  Shows one statistic of all samples (left) and of the recent samples
+ *  (right) (runs every 200ms). Taking the snapshots costs the same for any
+ *  number of samples.
+ */
+void displayStatistics(void) {
+	StatsSnapshot total, recent;
 
-		displayVoltageLabel(); // Display "Voltage: " on the screen
+	stats_snapshot(&adcTotal, &total);
+	stats_snapshot(&adcRecent, &recent);
 
-		uint16_t adcResult = getAdcValue(); // Read analog value from sensor
+	lcd_line1();
+	switch (statisticsPage) {
+		case 0:
+			lcd_writeProgString(PSTR("Mean "));
+			break;
+		case 1:
+			lcd_writeProgString(PSTR("Dev  "));
+			break;
+		case 2:
+			lcd_writeProgString(PSTR("Min  "));
+			break;
+		case 3:
+			lcd_writeProgString(PSTR("Max  "));
+			break;
+		default:
+			lcd_writeProgString(PSTR("P-P  "));
+			break;
+	}
+	lcd_printf_P(PSTR("n=%9lu"), total.count);
 
-		lcd_writeVoltage(adcResult, 1023, 5); // Display voltage (scaled to 5V, 10-bit resolution)
+	lcd_line2();
+	switch (statisticsPage) {
+		case 0:
+			writeStatisticVoltage(total.mean, 1023UL << 8);
+			lcd_writeProgString(PSTR("  "));
+			writeStatisticVoltage(recent.mean, 1023UL << 8);
+			break;
+		case 1:
+			writeStatisticVoltage(total.deviation, 1023UL << 4);
+			lcd_writeProgString(PSTR("  "));
+			writeStatisticVoltage(recent.deviation, 1023UL << 4);
+			break;
+		case 2:
+			writeStatisticVoltage(total.min, 1023);
+			lcd_writeProgString(PSTR("  "));
+			writeStatisticVoltage(recent.min, 1023);
+			break;
+		case 3:
+			writeStatisticVoltage(total.max, 1023);
+			lcd_writeProgString(PSTR("  "));
+			writeStatisticVoltage(recent.max, 1023);
+			break;
+		default:
+			writeStatisticVoltage(total.peakToPeak, 1023);
+			lcd_writeProgString(PSTR("  "));
+			writeStatisticVoltage(recent.peakToPeak, 1023);
+			break;
+	}
+}
 
-		// Compute and display binary LED representation
-		uint16_t invertedLedValue = computeLedValue(adcResult);
-		setLedBar(invertedLedValue); // Display inverted for correct visual output
+/*!
+ *  Prepares the statistics.
+ */
+void startStatistics(void) {
+	statisticsPage = 0;
+	lcd_clear();
+}
 
-		// If buffer is allocated, show stored voltage at current index
-		if (getBufferSize() != 0) {
-			displayVoltageBuffer(SpeicherCounter);
+/*!
+ *  Buttons of the statistics: UP/DOWN change the statistic, ENTER restarts
+ *  the window of all samples.
+ */
+void buttonStatistics(uint8_t button) {
+	if (button == OS_BUTTON_ENTER) {
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+			stats_reset(&adcTotal);
 		}
+	} else if (button == OS_BUTTON_UP) {
+		statisticsPage = (statisticsPage != STATISTICS_PAGES - 1) ? (statisticsPage + 1) : 0;
+	} else if (button == OS_BUTTON_DOWN) {
+		statisticsPage = (statisticsPage != 0) ? (statisticsPage - 1) : STATISTICS_PAGES - 1;
+	} else {
+		return;
+	}
 
-		uint8_t input = os_getInput(); // Get button input
+	displayStatistics();
+}
 
-		// Check if ENTER button is pressed, then store voltage
-		checkAndStoreVoltage(input); 
+/*!
+ *  Shows a sample of the frozen capture like the stored voltages: its time
+ *  relative to the trigger in the first line, index and voltage in the
+ *  second line.
+ */
+void displayCaptureSample(uint8_t index) {
+	lcd_line1();
+	lcd_printf_P(PSTR("t=%9.3lkms   "), capture_time(index));
+
+	lcd_line2();
+	lcd_writePaddedDec(index, 3);
+	lcd_printf_P(PSTR("/%u: "), CAPTURE_SIZE);
+	lcd_writeVoltage(capture_get(index), 1023, 5);
+}
 
-		// Handle UP/DOWN changes for SpeicherCounter
-		updateSpeicherCounter(&SpeicherCounter, input); 
+/*!
+ *  Shows the trigger while the capture is running, then the captured
+ *  samples (runs every 100ms).
+ */
+void displayScope(void) {
+	CaptureConfig const *const config = capture_config();
+	uint8_t const state = capture_state();
 
-		_delay_ms(100); // Wait 100ms before next loop (refresh rate)
+	if (state == CAPTURE_DONE) {
+		displayCaptureSample(scopeIndex);
+		return;
 	}
-	
+
+	lcd_line1();
+	lcd_writeProgString(PSTR("Trig "));
+	lcd_writeVoltage(config->level, 1023, 5);
+	lcd_writeProgString(config->edge == CAPTURE_RISING ? PSTR(" rise ") : PSTR(" fall "));
+
+	lcd_line2();
+	lcd_writeProgString(state == CAPTURE_ARMED ? PSTR("armed           ") : PSTR("triggered       "));
+}
+
+/*!
+ *  Arms a capture at the capture rate.
+ */
+void startScope(void) {
+	init_require(INIT_ADC);
+	lcd_clear();
+	supply_pause(true);
+	capture_arm();
+	scopeIndex = capture_triggerIndex();
+}
+
+/*!
+ *  Stops the capture and resumes the supply measurements.
+ */
+void leaveScope(void) {
+	capture_stop();
+	supply_pause(false);
+}
+
+/*!
+ *  Buttons of the scope. While waiting: UP/DOWN move the trigger level,
+ *  ENTER switches the edge. Afterwards: UP/DOWN browse the samples, ENTER
+ *  arms again.
+ */
+void buttonScope(uint8_t button) {
+	CaptureConfig *const config = capture_config();
+
+	if (capture_state() == CAPTURE_DONE) {
+		if (button == OS_BUTTON_ENTER) {
+			startScope();
+		} else if (button == OS_BUTTON_UP) {
+			scopeIndex = (scopeIndex + 1) & (CAPTURE_SIZE - 1);
+		} else if (button == OS_BUTTON_DOWN) {
+			scopeIndex = (scopeIndex - 1) & (CAPTURE_SIZE - 1);
+		}
+		displayScope();
+		return;
+	}
+
+	if (button == OS_BUTTON_ENTER) {
+		config->edge = (config->edge == CAPTURE_RISING) ? CAPTURE_FALLING : CAPTURE_RISING;
+	} else if (button == OS_BUTTON_UP) {
+		config->level = (config->level < 1023 - 32) ? config->level + 32 : 1023;
+	} else if (button == OS_BUTTON_DOWN) {
+		config->level = (config->level > 32) ? config->level - 32 : 0;
+	} else {
+		return;
+	}
+	capture_arm();
+	displayScope();
+}
+
+//! Frequencies of the tone detector in Hz (multiples of 5Hz at 1kHz)
+static const uint16_t tonesFrequencies[GOERTZEL_BINS] PROGMEM = { 50, 100, 250, 440 };
+
+/*!
+ *  Shows the amplitudes of two bins of the tone detector (runs every 200ms).
+ */
+void displayTones(void) {
+	uint8_t line;
+
+	for (line = 0; line < 2; line++) {
+		uint8_t const bin = (tonesBin + line) % GOERTZEL_BINS;
+
+		lcd_goto(line + 1, 1);
+		lcd_printf_P(PSTR("%4uHz "), goertzel_binFrequency(bin));
+		lcd_writeVoltage(goertzel_amplitude(bin), 1023, 5);
+	}
+}
+
+/*!
+ *  Starts the tone detector on the unfiltered samples.
+ */
+void startTones(void) {
+	uint8_t i;
+
+	init_require(INIT_ADC);
+	lcd_clear();
+	supply_pause(true);
+	tonesBin = 0;
+
+	goertzel_init(GOERTZEL_BLOCK);
+	for (i = 0; i < GOERTZEL_BINS; i++) {
+		goertzel_setBin(i, pgm_read_word(&tonesFrequencies[i]));
+	}
+}
+
+/*!
+ *  Stops the tone detector, it is not needed outside of its program, and
+ *  resumes the supply measurements.
+ */
+void leaveTones(void) {
+	goertzel_init(GOERTZEL_BLOCK);
+	supply_pause(false);
+}
+
+/*!
+ *  Buttons of the tone detector: UP/DOWN scroll through the bins.
+ */
+void buttonTones(uint8_t button) {
+	if (button == OS_BUTTON_UP) {
+		tonesBin = (tonesBin != GOERTZEL_BINS - 1) ? (tonesBin + 1) : 0;
+	} else if (button == OS_BUTTON_DOWN) {
+		tonesBin = (tonesBin != 0) ? (tonesBin - 1) : GOERTZEL_BINS - 1;
+	} else {
+		return;
+	}
+	displayTones();
+}
+
+//! Window of the alarm: 0.5V...4.5V, 0.1V hysteresis, 3 samples
+static const AlarmConfig alarmDefault PROGMEM = { 102, 921, 20, 3 };
+
+/*!
+ *  Shows the state of the alarm and an event of its log (runs every 200ms).
+ */
+void displayAlarm(void) {
+	AlarmEvent event;
+	uint8_t const state = alarm_state();
+
+	lcd_line1();
+	lcd_writeProgString(PSTR("Alarm "));
+	lcd_writeProgString(state == ALARM_HIGH ? PSTR("HIGH") : (state == ALARM_LOW ? PSTR(" LOW") : PSTR("  ok")));
+	lcd_printf_P(PSTR(" n=%3u"), alarm_eventCount());
+
+	lcd_line2();
+	if (!alarm_getEvent(alarmAge, &event)) {
+		lcd_writeProgString(PSTR("no event        "));
+		return;
+	}
+
+	// Type, value and time in seconds with one decimal
+	lcd_writeChar(event.type == ALARM_HIGH ? 'H' : (event.type == ALARM_LOW ? 'L' : '-'));
+	lcd_writeChar(' ');
+	lcd_writeVoltage(event.value, 1023, 5);
+	lcd_printf_P(PSTR("%7.1lks"), event.time / 100000);
+}
+
+/*!
+ *  Shows the newest event of the alarm and arms its LED. The supply
+ *  measurements are paused, they would make the comparator skip samples.
+ */
+void startAlarm(void) {
+	alarmAge = 0;
+	alarm_arm(true);
+	supply_pause(true);
+	lcd_clear();
+}
+
+/*!
+ *  Gives the alarm LED back to the LED bar and resumes the supply
+ *  measurements.
+ */
+void leaveAlarm(void) {
+	alarm_arm(false);
+	supply_pause(false);
+}
+
+/*!
+ *  Buttons of the alarm: UP/DOWN browse the log (UP = older), ENTER clears
+ *  it.
+ */
+void buttonAlarm(uint8_t button) {
+	uint16_t const count = alarm_eventCount();
+	uint8_t const events = (count < ALARM_LOG_SIZE) ? count : ALARM_LOG_SIZE;
+
+	if (button == OS_BUTTON_ENTER) {
+		AlarmConfig config;
+		alarm_getConfig(&config);
+		alarm_init(&config);
+		alarmAge = 0;
+	} else if (button == OS_BUTTON_UP) {
+		alarmAge = (alarmAge + 1 < events) ? (alarmAge + 1) : 0;
+	} else if (button == OS_BUTTON_DOWN) {
+		alarmAge = (alarmAge != 0) ? (alarmAge - 1) : (events ? events - 1 : 0);
+	} else {
+		return;
+	}
+	displayAlarm();
+}
+
+//! Range of the level meter on the LED bar and the LCD in tenths of a dB
+#define METER_RANGE_DB 480
+
+/*!
+ *  Maps a level in tenths of a dBFS to the range of the meter.
+ *
+ *  \param db     Level (METER_DB_MIN...0).
+ *  \param steps  Value of a full scale level.
+ *  \return       0...steps, below METER_RANGE_DB 0.
+ */
+uint8_t meterScale(int16_t db, uint8_t steps) {
+	if (db <= -METER_RANGE_DB) {
+		return 0;
+	}
+	return ((uint32_t)(db + METER_RANGE_DB) * steps) / METER_RANGE_DB;
+}
+
+/*!
+ *  Shows the level meter on the LED bar and the display (runs every 50ms,
+ *  the meter itself follows every sample).
+ */
+void displayMeter(void) {
+	MeterLevels levels;
+
+	meter_read(&levels);
+	setLedMeter(meterScale(levels.levelDb, 255), meterScale(levels.peakDb, 255));
+
+	lcd_line1();
+	lcd_printf_P(PSTR("%6.1kdB pk%5.1k"), levels.levelDb, levels.peakDb);
+	lcd_barDraw(2, meterScale(levels.levelDb, LCD_BAR_STEPS));
+}
+
+/*!
+ *  Prepares the level meter.
+ */
+void startMeter(void) {
+	activateLedMask = 0xFFFE; // Don't use LED 0
+	initLedBar();
+	init_require(INIT_ADC);
+	meter_init();
+	lcd_clear();
+	lcd_barInit();
+}
+
+//! Adaptive rate of the recorder: 125us...16ms, windows of 16 samples,
+//! 1...4 counts per sample, jumps of 64 counts (0.3V)
+static const RateConfig recorderRate PROGMEM = { 125, 16000, 4, 1, 4, 64 };
+
+/*!
+ *  Shows the progress of the recording, afterwards the recorded voltages
+ *  with their time (runs every 100ms).
+ */
+void displayRecorder(void) {
+	if (isAdcRecording()) {
+		lcd_line1();
+		lcd_printf_P(PSTR("Rec %3u/%3u     "), getBufferIndex(), getBufferSize());
+		lcd_line2();
+		lcd_printf_P(PSTR("%5uus act%5.1k"), getAdcSamplePeriod(), (rate_activity() * 10) >> 4);
+		return;
+	}
+
+	// The controller is not needed any more once the buffer is full
+	rate_stop();
+
+	lcd_line1();
+	lcd_printf_P(PSTR("t=%9.3lkms%3u"), getStoredTime(recorderIndex), rate_changes());
+	displayVoltageBuffer(recorderIndex);
+}
+
+/*!
+ *  Records the filtered samples with an adaptive sample rate.
+ */
+void startRecorder(void) {
+	RateConfig config;
+
+	init_require(INIT_ADC);
+	lcd_clear();
+	recorderIndex = 0;
+	supply_pause(true);
+
+	memcpy_P(&config, &recorderRate, sizeof(config));
+	rate_stop();
+	rate_start(&config);
+	startAdcRecording();
+}
+
+/*!
+ *  Stops the recording and the controller and resumes the supply
+ *  measurements.
+ */
+void leaveRecorder(void) {
+	stopAdcRecording();
+	rate_stop();
+	supply_pause(false);
+}
+
+/*!
+ *  Buttons of the recorder: UP/DOWN browse the recorded voltages, ENTER
+ *  records again.
+ */
+void buttonRecorder(uint8_t button) {
+	uint8_t const count = getBufferIndex();
+
+	if (isAdcRecording()) {
+		return;
+	}
+	if (button == OS_BUTTON_ENTER) {
+		startRecorder();
+		return;
+	} else if (button == OS_BUTTON_UP) {
+		recorderIndex = (recorderIndex + 1 < count) ? (recorderIndex + 1) : 0;
+	} else if (button == OS_BUTTON_DOWN) {
+		recorderIndex = (recorderIndex != 0) ? (recorderIndex - 1) : (count ? count - 1 : 0);
+	} else {
+		return;
+	}
+	displayRecorder();
+}
+
+/*!
+ *  Sample hook, runs in the ADC ISR with every sample. The alarm comes
+ *  first, its reaction time matters. The rate controller and the
+ *  statistics see the filtered samples; the alarm, the capture, the tone
+ *  detector and the level meter the unfiltered ones (the alarm must not
+ *  wait for the delay of the filters, the filters would hide the
+ *  transients the scope is meant to catch).
+ */
+void onSample(uint16_t raw, uint16_t filtered) {
+	alarm_sample(raw);
+	capture_sample(raw);
+	goertzel_sample(raw);
+	meter_sample(raw);
+	rate_sample(filtered);
+	stats_add(&adcTotal, filtered);
+	stats_add(&adcRecent, filtered);
+}
+
+//! Butterworth low pass at 1/20 of the sample rate (50Hz at 1kHz), Q14
+static const FilterBiquad filterLowPass PROGMEM = { 329, 658, 329, -25576, 10508 };
+
+//! Binomial FIR over 8 samples, Q15
+static const int16_t filterBinomial[8] PROGMEM = { 256, 1792, 5376, 8960, 8960, 5376, 1792, 256 };
+
+/*!
+ *  Replaces the filter chain of the ADC by a preset and writes its name.
+ *
+ *  \param preset  0...FILTER_PRESETS - 1.
+ */
+void applyFilterPreset(uint8_t preset) {
+	FilterChain *const chain = getAdcFilter();
+	FilterBiquad biquad;
+	int16_t coefficients[8];
+	const char *name;
+
+	memcpy_P(&biquad, &filterLowPass, sizeof(biquad));
+	memcpy_P(coefficients, filterBinomial, sizeof(coefficients));
+
+	// The ISR must never see a chain that is half built
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		filter_clear(chain);
+		switch (preset) {
+			case 0:
+				name = PSTR("none");
+				break;
+			case 1:
+				filter_addBoxcar(chain, 4);
+				name = PSTR("avg 16");
+				break;
+			case 2:
+				filter_addMedian(chain, 3);
+				filter_addBoxcar(chain, 2);
+				name = PSTR("med 3 + avg 4");
+				break;
+			case 3:
+				filter_addMedian(chain, 5);
+				name = PSTR("median 5");
+				break;
+			case 4:
+				filter_addIir1(chain, 2048);
+				name = PSTR("IIR a=1/16");
+				break;
+			case 5:
+				filter_addIir2(chain, &biquad);
+				name = PSTR("biquad fs/20");
+				break;
+			default:
+				filter_addFir(chain, coefficients, 8);
+				name = PSTR("FIR binomial 8");
+				break;
+		}
+	}
+	filterPreset = preset;
+
+	if (runningProgram != NO_PROGRAM) {
+		lcd_erase(1);
+		lcd_line1();
+		lcd_writeProgString(name);
+	}
+}
+
+//! Names of the ADC ranges, see ADC_RANGE_*
+static const char filterRangeNames[ADC_RANGES][3] PROGMEM = { "5V", "2V", "1V" };
+
+/*!
+ *  Shows the latest raw (with the resolution of its range) and filtered
+ *  values of the ADC and the range, marked with '*' while auto-ranging
+ *  (runs every 100ms).
+ */
+void displayFilter(void) {
+	uint16_t const sample = getAdcSample();
+	uint8_t const range = ADC_SAMPLE_RANGE(sample);
+
+	lcd_line2();
+	lcd_writeVoltage(ADC_SAMPLE_CODE(sample), getAdcRangeBound(range), 5);
+	lcd_writeChar('>');
+	lcd_writeVoltage(getAdcValue(), 1023, 5);
+	lcd_writeChar(isAdcAutoRange() ? '*' : ' ');
+	lcd_writeProgString(filterRangeNames[range]);
+}
+
+/*!
+ *  Shows the active filter preset.
+ */
+void startFilter(void) {
+	init_require(INIT_ADC);
+	lcd_clear();
+	applyFilterPreset(filterPreset);
+}
+
+/*!
+ *  Buttons of the filter program: UP/DOWN select the preset, ENTER the
+ *  range (auto, 5V, 2.56V, 1.1V).
+ */
+void buttonFilter(uint8_t button) {
+	if (button == OS_BUTTON_ENTER) {
+		uint8_t const range = getAdcRange();
+
+		if (isAdcAutoRange()) {
+			setAdcRange(ADC_RANGE_AVCC);
+		} else if (range == ADC_RANGES - 1) {
+			setAdcAutoRange(true);
+		} else {
+			setAdcRange(range + 1);
+		}
+	} else if (button == OS_BUTTON_UP) {
+		applyFilterPreset((filterPreset != FILTER_PRESETS - 1) ? (filterPreset + 1) : 0);
+	} else if (button == OS_BUTTON_DOWN) {
+		applyFilterPreset((filterPreset != 0) ? (filterPreset - 1) : FILTER_PRESETS - 1);
+	}
+}
+
+/*!
+ *  Buttons of the ADC program: UP/DOWN select the stored voltage.
+ */
+void buttonAdc(uint8_t button) {
+	updateSpeicherCounter(&SpeicherCounter, button);
+}
+
+static const char labelHelloWorld[] PROGMEM = "Hello world";
+static const char labelClock[] PROGMEM = "Binary clock";
+static const char labelAdc[] PROGMEM = "Internal ADC";
+static const char labelWaveform[] PROGMEM = "Waveform";
+static const char labelStatistics[] PROGMEM = "Statistics";
+static const char labelScope[] PROGMEM = "Scope (triggered capture)";
+static const char labelTones[] PROGMEM = "Tones (Goertzel detector)";
+static const char labelRecorder[] PROGMEM = "Recorder (adaptive rate)";
+static const char labelMeter[] PROGMEM = "Level meter";
+static const char labelAlarm[] PROGMEM = "Alarm (window comparator)";
+static const char labelFilter[] PROGMEM = "Filter and input range";
+static const char labelDiagnostics[] PROGMEM = "Diagnostics";
+
+//! Programs in the order of the menu. Add new programs here.
+static const MenuEntry menuEntries[] PROGMEM = {
+    { labelHelloWorld,  startHelloWorld,  helloWorld,         500, NULL,              NULL          },
+    { labelClock,       startClock,       displayClock,        10, NULL,              leaveClock    },
+    { labelAdc,         startAdc,         displayAdc,         100, buttonAdc,         NULL          },
+    { labelWaveform,    startWaveform,    displayWaveform,     20, NULL,              NULL          },
+    { labelScope,       startScope,       displayScope,       100, buttonScope,       leaveScope    },
+    { labelTones,       startTones,       displayTones,       200, buttonTones,       leaveTones    },
+    { labelRecorder,    startRecorder,    displayRecorder,    100, buttonRecorder,    leaveRecorder },
+    { labelMeter,       startMeter,       displayMeter,        50, NULL,              NULL          },
+    { labelAlarm,       startAlarm,       displayAlarm,       200, buttonAlarm,       leaveAlarm    },
+    { labelStatistics,  startStatistics,  displayStatistics,  200, buttonStatistics,  NULL          },
+    { labelFilter,      startFilter,      displayFilter,      100, buttonFilter,      NULL          },
+    { labelDiagnostics, startDiagnostics, displayDiagnostics, 500, buttonDiagnostics, NULL          },
+};
+
+//! Number of programs in the menu
+#define MENU_ENTRIES (sizeof(menuEntries) / sizeof(menuEntries[0]))
+
+/*!
+ *  Copies a program of the menu from the flash.
+ *
+ *  \param index  Index of the program.
+ *  \param entry  Receives the program.
+ */
+static void readMenuEntry(uint8_t index, MenuEntry *entry) {
+    memcpy_P(entry, &menuEntries[index], sizeof(*entry));
+}
+
+/*!
+ *  Shows the current menu entry in the second line. It is written into all
+ *  40 columns of the viewport, so an entry that is wider than the display
+ *  only costs one command per step of the marquee (see menuMarquee).
+ */
+void drawMenuEntry(void) {
+    MenuEntry entry;
+    char text[LCD_VIEWPORT_COLUMNS + 1];
+    uint8_t length = 0;
+
+    readMenuEntry(pageIndex, &entry);
+
+    // "n: label"
+    if (pageIndex >= 9) {
+        text[length++] = '0' + (pageIndex + 1) / 10;
+    }
+    text[length++] = '0' + (pageIndex + 1) % 10;
+    text[length++] = ':';
+    text[length++] = ' ';
+    strncpy_P(text + length, entry.label, LCD_VIEWPORT_COLUMNS - length);
+    text[LCD_VIEWPORT_COLUMNS] = '\0';
+
+    // Every entry starts at its beginning
+    lcd_viewportHome();
+    menuEntryLength = lcd_viewportWrite(2, text);
+}
+
+/*!
+ *  Shows the whole menu.
+ */
+void drawMenu(void) {
+    lcd_clear();
+
+    // Both lines are shifted together, "Select:" comes back with the entry
+    lcd_viewportWriteProg(1, PSTR("Select:"));
+    drawMenuEntry();
+}
+
+/*!
+ *  Moves a menu entry that is wider than the display by one column (runs
+ *  every MENU_MARQUEE_MS, only while the menu is shown).
+ */
+void menuMarquee(void) {
+    if (runningProgram == NO_PROGRAM) {
+        lcd_viewportMarquee(menuEntryLength);
+    }
 }
 
 /*! \brief Starts the passed program
+ *
+ * The program draws its screen and then refreshes it periodically from a
+ * timer of the scheduler until ESC is pressed.
  *
  * \param programIndex Index of the program to start.
  */
 void start(uint8_t programIndex) {
+    MenuEntry entry;
+
+    if (programIndex >= MENU_ENTRIES) {
+        return;
+    }
+
+    readMenuEntry(programIndex, &entry);
+    runningProgram = programIndex;
+
+    // Not every program clears the display, the columns have to match again
+    lcd_viewportHome();
+
     // Initialize and start the passed 'program'
-    switch (programIndex) {
-        case 0:
-            lcd_clear();
-            helloWorld();
-            break;
-        case 1:
-            activateLedMask = 0xFFFF; // Use all LEDs
-            initLedBar();
-            initClock();
-            displayClock();
-            break;
-        case 2:
-            activateLedMask = 0xFFFE; // Don't use LED 0
-            initLedBar();
-            initAdc();
-            displayAdc();
-            break;
-        default:
-            break;
+    if (entry.start) {
+        entry.start();
+    }
+    if (entry.background) {
+        refreshTimer = sched_startTimer(entry.background, 0, entry.period);
+    }
+}
+
+/*!
+ *  Stops the running program and shows the menu again.
+ */
+void stop(void) {
+    MenuEntry entry;
+
+    readMenuEntry(runningProgram, &entry);
+    if (entry.leave) {
+        entry.leave();
     }
 
-    // Do not resume to the menu until all buttons are released
-    os_waitForNoInput();
+    sched_stopTimer(refreshTimer);
+    refreshTimer = SCHED_NO_TIMER;
+    runningProgram = NO_PROGRAM;
+
+    drawMenu();
 }
 
 /*!
- *  Shows a user menu on the display which allows to start subprograms.
+ *  Reacts to a single button event.
+ *
+ *  \param event  Event from the queue of os_event.
  */
-void showMenu(void) {
-    uint8_t pageIndex = 0;
-
-    while (1) {
-        lcd_clear();
-        lcd_writeProgString(PSTR("Select:"));
-        lcd_line2();
-
-        switch (pageIndex) {
-            case 0:
-                lcd_writeProgString(PSTR("1: Hello world"));
-                break;
-            case 1:
-                lcd_writeProgString(PSTR("2: Binary clock"));
-                break;
-            case 2:
-                lcd_writeProgString(PSTR("3: Internal ADC"));
-                break;
-            default:
-                lcd_writeProgString(PSTR("----------------"));
-                break;
-        }
+void handleButton(uint8_t event) {
+    uint8_t const button = event & OS_EVENT_BUTTON;
+
+    // Only presses and their repetitions are used
+    if (!(event & (OS_EVENT_PRESS | OS_EVENT_REPEAT))) {
+        return;
+    }
 
-        os_waitForInput();
-        if (os_getInput() == 0b00000001) { // Enter
-            os_waitForNoInput();
-            start(pageIndex);
-        } else if (os_getInput() == 0b00000100) { // Up
-            os_waitForNoInput();
-            pageIndex = (pageIndex + 1) % 3;
-        } else if (os_getInput() == 0b00000010) { // Down
-            os_waitForNoInput();
-            if (pageIndex == 0) {
-                pageIndex = 2;
-            } else {
-                pageIndex--;
+    if (runningProgram != NO_PROGRAM) {
+        if (button == OS_BUTTON_ESC) {
+            stop();
+        } else {
+            void (*const handler)(uint8_t) = (void (*)(uint8_t))pgm_read_ptr(&menuEntries[runningProgram].button);
+            if (handler) {
+                handler(button);
             }
         }
+        return;
     }
+
+    if (button == OS_BUTTON_ENTER) { // Enter
+        start(pageIndex);
+    } else if (button == OS_BUTTON_UP) { // Up
+        if (++pageIndex == MENU_ENTRIES) {
+            pageIndex = 0;
+        }
+        drawMenuEntry();
+    } else if (button == OS_BUTTON_DOWN) { // Down
+        if (pageIndex == 0) {
+            pageIndex = MENU_ENTRIES;
+        }
+        pageIndex--;
+        drawMenuEntry();
+    }
+}
+
+/*!
+ *  Button task (posted by the event hook). Handles all queued button events
+ *  and measures the time from the edge until the display has been updated.
+ */
+void checkButtons(void) {
+    uint32_t time;
+    uint8_t event;
+
+    while ((event = os_getTimedEvent(&time)) != OS_EVENT_NONE) {
+        handleButton(event);
+
+        inputLatency = timebase_micros() - time;
+        if (inputLatency > maxInputLatency) {
+            maxInputLatency = inputLatency;
+        }
+    }
+}
+
+/*!
+ *  Event hook, runs in the ISR that queued button events. Wakes up the
+ *  scheduler with the button task.
+ */
+void postButtons(void) {
+    sched_post(checkButtons);
+}
+
+/*!
+ *  Shows a user menu on the display which allows to start subprograms.
+ *  Starts the tasks that keep running across all programs and hands the
+ *  CPU over to the scheduler.
+ */
+void showMenu(void) {
+    AlarmConfig alarmConfig;
+
+    sched_init();
+
+    // Normally done by main already, then this does nothing
+    init_require(INIT_ALL);
+
+    // The statistics follow the samples from the start
+    stats_init(&adcTotal, STATS_CUMULATIVE);
+    stats_init(&adcRecent, STATS_SLIDING);
+
+    // The ADC samples in the background, all programs see the filtered values
+    applyFilterPreset(FILTER_DEFAULT_PRESET);
+    capture_init();
+    goertzel_init(GOERTZEL_BLOCK);
+    meter_init();
+    memcpy_P(&alarmConfig, &alarmDefault, sizeof(alarmConfig));
+    alarm_init(&alarmConfig);
+    setAdcSampleHook(onSample);
+
+    // Buttons are handled as soon as an edge has been queued, no polling
+    os_flushEvents();
+    os_setEventHook(postButtons);
+    sched_startTimer(sampleAdc, 0, 20);
+    sched_startTimer(menuMarquee, MENU_MARQUEE_MS, MENU_MARQUEE_MS);
+    supply_start(SUPPLY_INTERVAL_MS);
+
+    drawMenu();
+    init_bootFinished();
+
+    sched_run();
 }
@@ -0,0 +1,136 @@
+#include "meter.h"
+#include "adc.h"
+
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
+
+/*! \file
+ *  Envelope follower and peak hold with a table based dBFS scale.
+ */
+
+//! Full scale: amplitude of the largest sine, 512 counts in Q16
+#define METER_FULL_SCALE_BIT 25
+
+//! Amplitudes below this bit are under METER_DB_MIN (60.2 tenths of a dB per bit)
+#define METER_SILENT_BIT (METER_FULL_SCALE_BIT + METER_DB_MIN / 60)
+
+//! 200 log10(1 + (i + 0.5) / 64): tenths of a dB of the 6 bits below the highest bit
+static const uint8_t meterLog[64] PROGMEM = {
+     1,  2,  3,  5,  6,  7,  8, 10, 11, 12, 13, 14, 15, 17, 18, 19,
+    20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35,
+    36, 37, 37, 38, 39, 40, 41, 42, 43, 43, 44, 45, 46, 47, 47, 48,
+    49, 50, 51, 51, 52, 53, 54, 54, 55, 56, 56, 57, 58, 58, 59, 60,
+};
+
+//! Mean of the samples (Q16)
+static uint32_t meterDc;
+
+//! Envelope and peak (Q16 counts)
+static uint32_t meterEnvelope, meterPeak;
+
+//! Samples the peak is still held
+static uint16_t meterHold;
+
+//! Samples per METER_PEAK_HOLD_MS
+static uint16_t meterHoldSamples;
+
+/*!
+ *  Resets the levels and starts the DC tracking at the middle of the range.
+ */
+void meter_init(void) {
+    uint16_t const hold = (uint32_t)METER_PEAK_HOLD_MS * 1000 / getAdcSamplePeriod();
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        meterDc = 512UL << 16;
+        meterEnvelope = 0;
+        meterPeak = 0;
+        meterHold = 0;
+        meterHoldSamples = hold;
+    }
+}
+
+/*!
+ *  Converts an amplitude to dBFS with the table.
+ *
+ *  \param amplitude  Amplitude in ADC counts << 16.
+ *  \return           Tenths of a dB relative to 512 counts, at least
+ *                    METER_DB_MIN.
+ */
+int16_t meter_toDb(uint32_t amplitude) {
+    uint8_t bit = 31;
+    uint8_t index;
+    int16_t db;
+
+    if (amplitude < (1UL << METER_SILENT_BIT)) {
+        return METER_DB_MIN;
+    }
+    while (!(amplitude & (1UL << bit))) {
+        bit--;
+    }
+    index = (bit >= 6) ? (amplitude >> (bit - 6)) & 63 : (amplitude << (6 - bit)) & 63;
+
+    // 60.2 tenths of a dB per bit (1927 / 32); the bit is at least
+    // METER_SILENT_BIT, so the product fits into an int16_t
+    db = (((int16_t)bit - METER_FULL_SCALE_BIT) * 1927 >> 5) + pgm_read_byte(&meterLog[index]);
+    if (db > 0) {
+        return 0;
+    }
+    return (db < METER_DB_MIN) ? METER_DB_MIN : db;
+}
+
+/*!
+ *  Reads the levels.
+ *
+ *  \param levels  Receives the levels.
+ */
+void meter_read(MeterLevels *levels) {
+    uint32_t envelope, peak;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        envelope = meterEnvelope;
+        peak = meterPeak;
+    }
+
+    levels->level = (envelope + 0x8000) >> 16;
+    levels->peak = (peak + 0x8000) >> 16;
+    levels->levelDb = meter_toDb(envelope);
+    levels->peakDb = meter_toDb(peak);
+}
+
+/*!
+ *  Updates the DC offset, the envelope and the peak. Runs in the ADC ISR.
+ *
+ *  \param sample  The sample (0...1023).
+ */
+void meter_sample(uint16_t sample) {
+    uint32_t const x = (uint32_t)sample << 16;
+    uint32_t magnitude;
+
+    // DC offset, the low pass moves up or down without signed shifts
+    if (x >= meterDc) {
+        magnitude = x - meterDc;
+        meterDc += magnitude >> METER_DC_SHIFT;
+    } else {
+        magnitude = meterDc - x;
+        meterDc -= magnitude >> METER_DC_SHIFT;
+    }
+
+    // Fast attack, slow release
+    if (magnitude > meterEnvelope) {
+        meterEnvelope += (magnitude - meterEnvelope) >> METER_ATTACK_SHIFT;
+    } else {
+        meterEnvelope -= (meterEnvelope - magnitude) >> METER_RELEASE_SHIFT;
+    }
+
+    // The peak is held, then it falls back to the envelope like a release
+    if (magnitude >= meterPeak) {
+        meterPeak = magnitude;
+        meterHold = meterHoldSamples;
+    } else if (meterHold) {
+        meterHold--;
+    } else if (meterPeak > meterEnvelope) {
+        meterPeak -= (meterPeak - meterEnvelope) >> METER_RELEASE_SHIFT;
+    } else {
+        meterPeak = meterEnvelope;
+    }
+}
@@ -0,0 +1,59 @@
+/*! \file
+ *  \brief Level meter of the ADC samples.
+ *
+ *  Works like the level meter of an audio device. The signal is the
+ *  deviation of the samples from their mean (the DC offset is tracked by a
+ *  slow low pass and removed). Its magnitude drives an envelope follower
+ *  with a fast attack and a slow release, and a peak detector that holds
+ *  the highest sample for METER_PEAK_HOLD_MS and then falls back to the
+ *  envelope. meter_sample runs at the full sample rate in the ADC ISR,
+ *  with integer shifts and additions only (estimated at about 90 cycles per
+ *  sample, not measured).
+ *
+ *  The levels are read as ADC counts or in dBFS (tenths of a dB relative
+ *  to a full scale sine, 512 counts). The logarithm comes from a PROGMEM
+ *  table: the position of the highest bit gives the multiple of 6.02dB,
+ *  the next 6 bits index the table.
+ */
+
+#ifndef _METER_H
+#define _METER_H
+
+#include <stdint.h>
+
+//! Attack: the envelope moves by 2^-METER_ATTACK_SHIFT of the difference per sample
+#define METER_ATTACK_SHIFT 2
+
+//! Release: the envelope falls by 2^-METER_RELEASE_SHIFT of the difference per sample
+#define METER_RELEASE_SHIFT 8
+
+//! The DC offset follows the samples with 2^-METER_DC_SHIFT per sample
+#define METER_DC_SHIFT 10
+
+//! Milliseconds the peak is held
+#define METER_PEAK_HOLD_MS 1500
+
+//! Level of silence in tenths of a dB
+#define METER_DB_MIN (-600)
+
+//! Levels of the meter
+typedef struct {
+    uint16_t level;  //!< Envelope in ADC counts (amplitude)
+    uint16_t peak;   //!< Held peak in ADC counts
+    int16_t levelDb; //!< Envelope in tenths of a dBFS (<= 0)
+    int16_t peakDb;  //!< Held peak in tenths of a dBFS (<= 0)
+} MeterLevels;
+
+//! Resets the meter, the peak hold time follows the current sample rate
+void meter_init(void);
+
+//! Reads the current levels
+void meter_read(MeterLevels *levels);
+
+//! Converts an amplitude in 1/65536 ADC counts to tenths of a dBFS
+int16_t meter_toDb(uint32_t amplitude);
+
+//! Feeds a sample (0...1023), called by the ADC ISR
+void meter_sample(uint16_t sample);
+
+#endif
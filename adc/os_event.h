@@ -0,0 +1,155 @@
+/*! \file
+ *  \brief Debounced button events.
+ *
+ *  The buttons are sampled at a fixed tick. Every button has an integrator
+ *  that counts up while the pin reads pressed and down while it reads
+ *  released; the debounced state only changes when the integrator reaches
+ *  its limit, so a bouncing contact never produces more than one edge.
+ *  Edges are turned into press, release, long-press and auto-repeat events
+ *  and stored in a small queue that the ISRs (producers) and the program
+ *  (consumer) share without disabling interrupts. Every event carries a
+ *  timestamp in microseconds, so the latency from the input to the reaction
+ *  can be measured.
+ *
+ *  In addition, the buttons can raise a pin change interrupt. A press of a
+ *  button that is at rest is then reported right away, with the time of the
+ *  edge, instead of after the debounce time. The integrator is set to its
+ *  limit, so the bouncing that follows is absorbed; releases are still
+ *  debounced by the tick. A pin change also wakes the CPU from sleep, and
+ *  the event hook lets a program react from there without polling.
+ *
+ *  The module is the same in every project. The pins, the buttons in use
+ *  and the source of the tick are configured in os_input.h:
+ *    - OS_EVENT_BUTTONS: mask of the OS_BUTTON_* bits that exist
+ *    - OS_EVENT_OWN_TIMER: 1 to tick from Timer2, 0 if os_eventTick is
+ *      called by another timer ISR every OS_EVENT_TICK_MS
+ *    - OS_EVENT_TIMESTAMP(): microsecond clock, required without own timer
+ *    - OS_EVENT_PCINT_MASK: PCMSK2 bits of the buttons on port C that raise
+ *      a pin change interrupt (0 or undefined: no pin change interrupt)
+ *  The timing parameters below can be overridden there as well.
+ */
+
+#ifndef _OS_EVENT_H
+#define _OS_EVENT_H
+
+#include <stdint.h>
+
+#include "os_input.h"
+
+//----------------------------------------------------------------------------
+// Configuration
+//----------------------------------------------------------------------------
+
+#ifndef OS_EVENT_BUTTONS
+    #error "OS_EVENT_BUTTONS has to be defined in os_input.h"
+#endif
+
+#ifndef OS_EVENT_OWN_TIMER
+    #define OS_EVENT_OWN_TIMER 1
+#endif
+
+#if !OS_EVENT_OWN_TIMER && !defined(OS_EVENT_TIMESTAMP)
+    #error "OS_EVENT_TIMESTAMP has to be defined in os_input.h without own timer"
+#endif
+
+#ifndef OS_EVENT_PCINT_MASK
+    #define OS_EVENT_PCINT_MASK 0
+#endif
+
+//! Milliseconds between two samples of the buttons
+#ifndef OS_EVENT_TICK_MS
+    #define OS_EVENT_TICK_MS 1
+#endif
+
+//! Milliseconds a button has to be stable before its state changes
+#ifndef OS_EVENT_DEBOUNCE_MS
+    #define OS_EVENT_DEBOUNCE_MS 5
+#endif
+
+//! Milliseconds a button has to be held for a long press
+#ifndef OS_EVENT_LONG_MS
+    #define OS_EVENT_LONG_MS 800
+#endif
+
+//! Buttons that repeat while they are held (see os_setRepeat)
+#ifndef OS_EVENT_REPEAT_BUTTONS
+    #define OS_EVENT_REPEAT_BUTTONS OS_EVENT_BUTTONS
+#endif
+
+//! Milliseconds from the press to the first repeat event
+#ifndef OS_EVENT_REPEAT_DELAY_MS
+    #define OS_EVENT_REPEAT_DELAY_MS 500
+#endif
+
+//! Milliseconds between repeat events
+#ifndef OS_EVENT_REPEAT_PERIOD_MS
+    #define OS_EVENT_REPEAT_PERIOD_MS 150
+#endif
+
+//! Number of events that can wait at the same time (power of 2)
+#ifndef OS_EVENT_QUEUE_SIZE
+    #define OS_EVENT_QUEUE_SIZE 8
+#endif
+
+//----------------------------------------------------------------------------
+// Events
+//----------------------------------------------------------------------------
+
+// An event is one of the types below or'ed with the OS_BUTTON_* bit
+
+//! Returned by os_getEvent if the queue is empty
+#define OS_EVENT_NONE 0x00
+
+//! The button has been pressed
+#define OS_EVENT_PRESS 0x10
+
+//! The button has been released
+#define OS_EVENT_RELEASE 0x20
+
+//! The button has been held for OS_EVENT_LONG_MS (once per press)
+#define OS_EVENT_LONG 0x40
+
+//! The button is still held (auto-repeat)
+#define OS_EVENT_REPEAT 0x80
+
+//! Mask of the event type
+#define OS_EVENT_TYPE 0xF0
+
+//! Mask of the button
+#define OS_EVENT_BUTTON 0x0F
+
+//! Called from ISR context after events have been queued
+typedef void (*OsEventHook)(void);
+
+//----------------------------------------------------------------------------
+// Function headers
+//----------------------------------------------------------------------------
+
+//! Resets the debouncing and the queue, starts Timer2 and the pin change interrupt if configured
+void os_initEvents(void);
+
+//! Samples the buttons once, called every OS_EVENT_TICK_MS from a timer ISR (never from main)
+void os_eventTick(void);
+
+//! Returns the next event or OS_EVENT_NONE
+uint8_t os_getEvent(void);
+
+//! Returns the next event or OS_EVENT_NONE and stores the microseconds at which it happened
+uint8_t os_getTimedEvent(uint32_t *time);
+
+//! Drops all queued events
+void os_flushEvents(void);
+
+//! Returns the debounced button states
+uint8_t os_getButtons(void);
+
+//! Sets the buttons that repeat, and the delay and period of the repetition in ms
+void os_setRepeat(uint8_t buttons, uint16_t delayMs, uint16_t periodMs);
+
+//! Sets a function that is called (in ISR context) whenever events have been queued
+void os_setEventHook(OsEventHook hook);
+
+//! Returns the current time in microseconds, in the same clock as the event timestamps
+uint32_t os_eventMicros(void);
+
+#endif
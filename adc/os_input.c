@@ -1,7 +1,10 @@
 #include "os_input.h"
+#include "os_event.h"
+#include "timebase.h"
 
 #include <avr/io.h>
 #include <stdint.h>
+#include <avr/sleep.h>
 
 /*! \file
  *  Functions for reading button input from the evaluation board.
@@ -33,7 +36,8 @@ uint8_t os_getInput(void) {
 }
 
 /*!
- *  Configures PORTC for button input with pull-up resistors.
+ *  Configures PORTC for button input with pull-up resistors and starts the
+ *  debouncing, which is sampled by the tick of the timebase.
  */
 void os_initInput() {
     // Set PC0, PC1, PC6, PC7 as inputs by clearing their bits in DDRC
@@ -42,22 +46,29 @@ void os_initInput() {
     // Enable internal pull-up resistors by setting bits in PORTC
     // This ensures the pins read HIGH when buttons are not pressed
     PORTC |= (1 << PC0) | (1 << PC1) | (1 << PC6) | (1 << PC7);
+
+    os_initEvents();
+    timebase_init();
 }
 
 /*!
- *  Blocks execution until all buttons are released.
+ *  Blocks execution until all buttons are released (debounced). The CPU
+ *  sleeps until the next tick in between.
  */
 void os_waitForNoInput() {
-    while (os_getInput() != 0) {
-        // Wait until no button is pressed
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    while (os_getButtons() != 0) {
+        sleep_mode();
     }
 }
 
 /*!
- *  Blocks execution until at least one button is pressed.
+ *  Blocks execution until at least one button is pressed (debounced). The CPU
+ *  sleeps until the next tick in between.
  */
 void os_waitForInput() {
-    while (os_getInput() == 0) {
-        // Wait until a button is pressed
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    while (os_getButtons() == 0) {
+        sleep_mode();
     }
 }
@@ -11,6 +11,44 @@
 #define _OS_INPUT_H
 
 #include <stdint.h>
+#include <avr/io.h>
+
+#include "timebase.h"
+
+//----------------------------------------------------------------------------
+// Constants
+//----------------------------------------------------------------------------
+
+//! Bit of the ENTER button (PC0) in the value of os_getInput
+#define OS_BUTTON_ENTER 0b00000001
+
+//! Bit of the DOWN button (PC1) in the value of os_getInput
+#define OS_BUTTON_DOWN 0b00000010
+
+//! Bit of the UP button (PC6) in the value of os_getInput
+#define OS_BUTTON_UP 0b00000100
+
+//! Bit of the ESC button (PC7) in the value of os_getInput
+#define OS_BUTTON_ESC 0b00001000
+
+//----------------------------------------------------------------------------
+// Configuration of os_event
+//----------------------------------------------------------------------------
+
+//! Buttons on this board
+#define OS_EVENT_BUTTONS (OS_BUTTON_ENTER | OS_BUTTON_DOWN | OS_BUTTON_UP | OS_BUTTON_ESC)
+
+//! Only UP and DOWN repeat (scrolling)
+#define OS_EVENT_REPEAT_BUTTONS (OS_BUTTON_DOWN | OS_BUTTON_UP)
+
+//! The buttons are sampled by the 1ms tick of the timebase
+#define OS_EVENT_OWN_TIMER 0
+
+//! Event timestamps are taken from the timebase
+#define OS_EVENT_TIMESTAMP() timebase_micros()
+
+//! All buttons (PC0, PC1, PC6, PC7) report presses by pin change interrupt
+#define OS_EVENT_PCINT_MASK ((1 << PCINT16) | (1 << PCINT17) | (1 << PCINT22) | (1 << PCINT23))
 
 //----------------------------------------------------------------------------
 // Function headers
@@ -19,7 +57,7 @@
 //! Initializes the respective Pins for the buttons, i.e. sets DDR and Pull ups
 void os_initInput(void);
 
-//! Refreshes the button states
+//! Reads the raw button states (not debounced)
 uint8_t os_getInput(void);
 
 //! Waits for all buttons to be released
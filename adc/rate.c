@@ -0,0 +1,144 @@
+#include "rate.h"
+#include "adc.h"
+
+#include <stdbool.h>
+#include <util/atomic.h>
+
+/*! \file
+ *  Sample rate controller driven by the slope of the signal.
+ */
+
+//! Settings
+static RateConfig rateConfig;
+
+//! Whether the controller runs
+static volatile bool rateRunning;
+
+//! Current period and the one to restore
+static uint16_t ratePeriod, rateSavedPeriod;
+
+//! Previous sample
+static uint16_t rateLast;
+
+//! Samples and sum of the absolute slopes of the running window
+static uint8_t rateCount;
+static uint16_t rateSum;
+
+//! Mean slope of the last window (Q4)
+static volatile uint16_t rateActivity;
+
+//! Changes of the period
+static volatile uint16_t rateChanges;
+
+/*!
+ *  Starts the controller.
+ *
+ *  \param config  The settings, copied.
+ */
+void rate_start(RateConfig const *config) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        rateConfig = *config;
+        if (rateConfig.minPeriodUs < ADC_MIN_PERIOD_US) {
+            rateConfig.minPeriodUs = ADC_MIN_PERIOD_US;
+        }
+        if (rateConfig.windowShift > 6) {
+            rateConfig.windowShift = 6;
+        }
+
+        rateSavedPeriod = ratePeriod = getAdcSamplePeriod();
+        rateLast = getAdcValue();
+        rateCount = 0;
+        rateSum = 0;
+        rateActivity = 0;
+        rateChanges = 0;
+        rateRunning = true;
+    }
+}
+
+/*!
+ *  Stops the controller and restores the sample period.
+ */
+void rate_stop(void) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (rateRunning) {
+            rateRunning = false;
+            setAdcSamplePeriod(rateSavedPeriod);
+        }
+    }
+}
+
+/*!
+ *  \return The number of changes of the period since rate_start.
+ */
+uint16_t rate_changes(void) {
+    uint16_t changes;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        changes = rateChanges;
+    }
+    return changes;
+}
+
+/*!
+ *  \return The mean absolute slope of the last window in counts per
+ *          sample, Q4.
+ */
+uint16_t rate_activity(void) {
+    uint16_t activity;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        activity = rateActivity;
+    }
+    return activity;
+}
+
+/*!
+ *  Sets a new period and starts a new window.
+ *
+ *  \param period  Microseconds.
+ */
+static void rate_set(uint16_t period) {
+    if (period != ratePeriod) {
+        ratePeriod = period;
+        setAdcSamplePeriod(period);
+        rateChanges++;
+    }
+    rateCount = 0;
+    rateSum = 0;
+}
+
+/*!
+ *  Adds a sample to the activity and adapts the period at the end of a
+ *  window. Runs in the ADC ISR.
+ *
+ *  \param sample  The sample (0...1023).
+ */
+void rate_sample(uint16_t sample) {
+    uint16_t slope;
+
+    if (!rateRunning) {
+        return;
+    }
+
+    slope = (sample > rateLast) ? sample - rateLast : rateLast - sample;
+    rateLast = sample;
+
+    if (slope >= rateConfig.burst) {
+        rate_set(rateConfig.minPeriodUs);
+        return;
+    }
+
+    rateSum += slope;
+    if (++rateCount >> rateConfig.windowShift == 0) {
+        return;
+    }
+
+    // Mean slope of the window: the sum is compared with the thresholds
+    // times the window
+    rateActivity = ((uint32_t)rateSum << 4) >> rateConfig.windowShift;
+    if (rateSum > ((uint16_t)rateConfig.highActivity << rateConfig.windowShift)) {
+        rate_set((ratePeriod / 2 > rateConfig.minPeriodUs) ? ratePeriod / 2 : rateConfig.minPeriodUs);
+    } else if (rateSum < ((uint16_t)rateConfig.lowActivity << rateConfig.windowShift)) {
+        rate_set((ratePeriod < rateConfig.maxPeriodUs / 2) ? ratePeriod * 2 : rateConfig.maxPeriodUs);
+    } else {
+        rate_set(ratePeriod);
+    }
+}
@@ -0,0 +1,50 @@
+/*! \file
+ *  \brief Adaptive sample rate of the ADC.
+ *
+ *  Estimates the activity of the signal as the mean absolute slope (change
+ *  from one sample to the next) over a window of samples. A busy signal
+ *  halves the sample period, a quiet one doubles it, within the configured
+ *  limits. A single jump by more than the burst threshold switches to the
+ *  shortest period at once, so a fast event that starts while the rate is
+ *  low is sampled at the full rate from the next conversion on.
+ *
+ *  A slope per sample halves when the rate doubles, so the high threshold
+ *  has to be more than twice the low one, or the rate would oscillate.
+ *
+ *  The ADC logs the time of every stored voltage (getStoredTime), so a
+ *  recording with a varying rate keeps its timeline.
+ *  rate_sample runs in the ADC ISR (estimated at about 40 cycles, 60 at
+ *  the end of a window, no divisions).
+ */
+
+#ifndef _RATE_H
+#define _RATE_H
+
+#include <stdint.h>
+
+//! Settings of the controller
+typedef struct {
+    uint16_t minPeriodUs;  //!< Shortest sample period (at least ADC_MIN_PERIOD_US)
+    uint16_t maxPeriodUs;  //!< Longest sample period
+    uint8_t windowShift;   //!< Samples per decision are 2^windowShift (0...6)
+    uint8_t lowActivity;   //!< Mean slope (counts per sample) below which the rate halves
+    uint8_t highActivity;  //!< Mean slope above which the rate doubles (> 2 * lowActivity)
+    uint16_t burst;        //!< Jump between two samples that selects the shortest period at once
+} RateConfig;
+
+//! Starts the controller (the current period is the start value) and remembers the period to restore
+void rate_start(RateConfig const *config);
+
+//! Stops the controller and restores the period of the ADC from before rate_start
+void rate_stop(void);
+
+//! Returns the number of changes of the period since rate_start
+uint16_t rate_changes(void);
+
+//! Returns the mean slope of the last window in counts per sample (Q4)
+uint16_t rate_activity(void);
+
+//! Feeds a sample (0...1023), called by the ADC ISR
+void rate_sample(uint16_t sample);
+
+#endif
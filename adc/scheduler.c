@@ -0,0 +1,177 @@
+#include "scheduler.h"
+#include "timebase.h"
+
+#include <stddef.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <util/atomic.h>
+
+/*! \file
+ *  Software timers and a task queue on top of the timebase.
+ */
+
+//! A software timer
+typedef struct {
+    Task task;       //!< Task to run, NULL if the timer is free
+    uint32_t due;    //!< Millisecond counter value of the next run
+    uint16_t period; //!< Period in milliseconds, 0 for a one-shot timer
+} SoftTimer;
+
+//! Software timers
+static SoftTimer schedTimers[SCHED_TIMERS];
+
+//! Posted tasks (ring buffer)
+static Task volatile schedQueue[SCHED_QUEUE_SIZE];
+
+//! Read and write positions of the queue
+static volatile uint8_t schedHead, schedTail;
+
+//! Called when there is nothing to do
+static Task schedIdleHook;
+
+/*!
+ *  Stops all timers, drops all posted tasks and makes sure the timebase
+ *  is running.
+ */
+void sched_init(void) {
+    uint8_t i;
+    for (i = 0; i < SCHED_TIMERS; i++) {
+        schedTimers[i].task = NULL;
+    }
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        schedHead = schedTail = 0;
+    }
+    schedIdleHook = NULL;
+
+    timebase_init();
+}
+
+/*!
+ *  Starts a software timer.
+ *
+ *  \param task      Task to be run.
+ *  \param delayMs   Milliseconds until the first run.
+ *  \param periodMs  Milliseconds between runs, 0 to run the task only once.
+ *  \return          ID of the timer or SCHED_NO_TIMER if all timers are in use.
+ */
+uint8_t sched_startTimer(Task task, uint16_t delayMs, uint16_t periodMs) {
+    uint8_t i;
+    for (i = 0; i < SCHED_TIMERS; i++) {
+        if (!schedTimers[i].task) {
+            schedTimers[i].due = timebase_millis() + delayMs;
+            schedTimers[i].period = periodMs;
+            schedTimers[i].task = task;
+            return i;
+        }
+    }
+    return SCHED_NO_TIMER;
+}
+
+/*!
+ *  Stops a software timer. Stopping a timer that is not running (including
+ *  SCHED_NO_TIMER) does nothing.
+ *
+ *  \param timer  ID of the timer as returned by sched_startTimer.
+ */
+void sched_stopTimer(uint8_t timer) {
+    if (timer < SCHED_TIMERS) {
+        schedTimers[timer].task = NULL;
+    }
+}
+
+/*!
+ *  Queues a task. It will run after the currently running task.
+ *
+ *  \param task  Task to be run.
+ *  \return      False if the queue is full.
+ */
+bool sched_post(Task task) {
+    bool posted = false;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        uint8_t const next = (schedTail + 1) & (SCHED_QUEUE_SIZE - 1);
+        if (next != schedHead) {
+            schedQueue[schedTail] = task;
+            schedTail = next;
+            posted = true;
+        }
+    }
+    return posted;
+}
+
+/*!
+ *  Sets the idle hook. It is called whenever a round of the scheduler found
+ *  nothing to do. Without a hook, the CPU sleeps until the next interrupt
+ *  (at the latest the next tick of the timebase).
+ *
+ *  \param hook  The idle hook or NULL.
+ */
+void sched_setIdleHook(Task hook) {
+    schedIdleHook = hook;
+}
+
+/*!
+ *  Runs all due timers and all queued tasks. If there was nothing to do,
+ *  the idle hook is called or the CPU sleeps.
+ */
+void sched_runOnce(void) {
+    uint32_t const now = timebase_millis();
+    bool busy = false;
+    uint8_t i;
+
+    for (i = 0; i < SCHED_TIMERS; i++) {
+        SoftTimer *const timer = &schedTimers[i];
+        Task const task = timer->task;
+
+        if (!task || (int32_t)(now - timer->due) < 0) {
+            continue;
+        }
+
+        if (timer->period) {
+            // Keep the period without drift, but skip runs that were missed
+            do {
+                timer->due += timer->period;
+            } while ((int32_t)(now - timer->due) >= 0);
+        } else {
+            timer->task = NULL;
+        }
+        task();
+        busy = true;
+    }
+
+    while (schedHead != schedTail) {
+        Task const task = schedQueue[schedHead];
+        schedHead = (schedHead + 1) & (SCHED_QUEUE_SIZE - 1);
+        task();
+        busy = true;
+    }
+
+    if (busy) {
+        return;
+    }
+
+    if (schedIdleHook) {
+        schedIdleHook();
+        return;
+    }
+
+    // Sleep unless an ISR posted a task after the check above. sei() takes
+    // effect after the next instruction, so no interrupt is lost in between.
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    cli();
+    if (schedHead == schedTail) {
+        sleep_enable();
+        sei();
+        sleep_cpu();
+        sleep_disable();
+    }
+    sei();
+}
+
+/*!
+ *  Runs the scheduler forever.
+ */
+void sched_run(void) {
+    while (1) {
+        sched_runOnce();
+    }
+}
@@ -0,0 +1,53 @@
+/*! \file
+ *  \brief Cooperative scheduler.
+ *
+ *  Runs short tasks to completion, one after the other, instead of letting
+ *  every program own the CPU in a delay loop. Tasks are started by
+ *  periodic or one-shot software timers based on the millisecond counter of
+ *  the timebase, or posted to a queue (also from ISRs). When there is
+ *  nothing to do, the idle hook runs or the CPU sleeps until the next
+ *  interrupt.
+ *
+ *  A task must not block: it does its work and returns.
+ */
+
+#ifndef _SCHEDULER_H
+#define _SCHEDULER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//! Number of software timers
+#define SCHED_TIMERS 8
+
+//! Number of posted tasks that can wait at the same time (power of 2)
+#define SCHED_QUEUE_SIZE 8
+
+//! Returned instead of a timer ID if no timer is free, ignored by sched_stopTimer
+#define SCHED_NO_TIMER 0xFF
+
+//! A run-to-completion task
+typedef void (*Task)(void);
+
+//! Resets all timers and the task queue and starts the timebase
+void sched_init(void);
+
+//! Runs task after delayMs and then every periodMs (0 = once), returns the timer ID
+uint8_t sched_startTimer(Task task, uint16_t delayMs, uint16_t periodMs);
+
+//! Stops a timer
+void sched_stopTimer(uint8_t timer);
+
+//! Queues a task to be run as soon as possible (may be called from ISRs)
+bool sched_post(Task task);
+
+//! Sets a function to be called when there is nothing to do (NULL = sleep)
+void sched_setIdleHook(Task hook);
+
+//! Runs all due timers and queued tasks once, or idles
+void sched_runOnce(void);
+
+//! Runs the scheduler forever
+void sched_run(void);
+
+#endif
@@ -0,0 +1,175 @@
+#include "stats.h"
+
+#include <string.h>
+#include <util/atomic.h>
+
+/*! \file
+ *  Constant time statistics with cheap snapshots.
+ */
+
+#if STATS_SLIDING_SHIFT < 8 || STATS_SLIDING_SHIFT > 15
+    #error "STATS_SLIDING_SHIFT has to be 8...15"
+#endif
+
+/*!
+ *  Integer square root.
+ *
+ *  \param value  Radicand.
+ *  \return       floor(sqrt(value)).
+ */
+static uint16_t stats_sqrt(uint32_t value) {
+    uint32_t root = 0;
+    uint32_t bit = 1UL << 30;
+
+    while (bit > value) {
+        bit >>= 2;
+    }
+    while (bit) {
+        if (value >= root + bit) {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+/*!
+ *  Initializes a window.
+ *
+ *  \param stats  The window.
+ *  \param mode   STATS_CUMULATIVE or STATS_SLIDING.
+ */
+void stats_init(Stats *stats, uint8_t mode) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        stats->mode = mode;
+        stats_reset(stats);
+    }
+}
+
+/*!
+ *  Drops all samples of a window.
+ *
+ *  \param stats  The window.
+ */
+void stats_reset(Stats *stats) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        stats->count = 0;
+        stats->min = stats->lastMin = 0xFFFF;
+        stats->max = stats->lastMax = 0;
+        stats->sum = 0;
+        stats->sumSquares = 0;
+        stats->mean = 0;
+        stats->variance = 0;
+    }
+}
+
+/*!
+ *  Adds a sample. Takes constant time and uses no division, so it can run
+ *  in the ISR of the acquisition. Must not be called from two contexts at
+ *  the same time.
+ *
+ *  \param stats   The window.
+ *  \param sample  The sample (0...4095).
+ */
+void stats_add(Stats *stats, uint16_t sample) {
+    if (stats->count != 0xFFFFFFFF) {
+        stats->count++;
+    }
+
+    if (sample < stats->min) {
+        stats->min = sample;
+    }
+    if (sample > stats->max) {
+        stats->max = sample;
+    }
+
+    if (stats->mode == STATS_CUMULATIVE) {
+        stats->sum += sample;
+        stats->sumSquares += (uint32_t)sample * sample;
+        return;
+    }
+
+    if (stats->count == 1) {
+        // The first sample starts the mean, the variance is 0
+        stats->mean = (int32_t)sample << 16;
+        return;
+    }
+
+    // Exponentially weighted mean and variance:
+    //   diff = x - mean, mean += a * diff,
+    //   variance = (1 - a) * (variance + a * diff^2)
+    // Mean and variance are Q16, the square is taken of the rounded diff in
+    // Q4 (fits into 16 bits). That Q8 square is a * diff^2 in Q16 for
+    // a = 2^-8, smaller weights shift it further.
+    int32_t const diff = ((int32_t)sample << 16) - stats->mean;
+    uint16_t const magnitude = ((uint32_t)(diff < 0 ? -diff : diff) + 2048) >> 12;
+    uint64_t const variance = stats->variance
+        + ((uint32_t)magnitude * magnitude >> (STATS_SLIDING_SHIFT - 8));
+
+    stats->mean += (diff + (1L << (STATS_SLIDING_SHIFT - 1))) >> STATS_SLIDING_SHIFT;
+    stats->variance = variance - (variance >> STATS_SLIDING_SHIFT);
+
+    // Min/max of the last complete block and the current one
+    if ((stats->count & (STATS_BLOCK - 1)) == 0) {
+        stats->lastMin = stats->min;
+        stats->lastMax = stats->max;
+        stats->min = 0xFFFF;
+        stats->max = 0;
+    }
+}
+
+/*!
+ *  Takes a snapshot of a window. Only the copy of the accumulators runs
+ *  with interrupts disabled, the results are computed afterwards.
+ *
+ *  \param stats     The window.
+ *  \param snapshot  Receives the results. All values are 0 if the window
+ *                   is empty.
+ */
+void stats_snapshot(Stats const *stats, StatsSnapshot *snapshot) {
+    Stats copy;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        memcpy(&copy, stats, sizeof(copy));
+    }
+
+    memset(snapshot, 0, sizeof(*snapshot));
+    if (!copy.count) {
+        return;
+    }
+
+    snapshot->count = copy.count;
+
+    if (copy.mode == STATS_CUMULATIVE) {
+        snapshot->min = copy.min;
+        snapshot->max = copy.max;
+
+        // With sum = q * n + r, the squared deviations from the mean are
+        //   sumSquares - sum^2 / n = (sumSquares - q^2 n - 2 q r) - r^2 / n
+        // The first term is the exact sum of (x - q)^2, nothing overflows
+        // and nothing cancels.
+        uint64_t const n = copy.count;
+        uint64_t const q = copy.sum / n;
+        uint64_t const r = copy.sum - q * n;
+        uint64_t const deviations = copy.sumSquares - q * q * n - 2 * q * r;
+        uint64_t const rr = r * r;
+        uint64_t const correction = ((rr / n) << 8) + ((rr % n) << 8) / n;
+
+        snapshot->mean = (copy.sum << 8) / n;
+        snapshot->variance = ((deviations << 8) - correction) / n;
+    } else {
+        snapshot->min = (copy.min < copy.lastMin) ? copy.min : copy.lastMin;
+        snapshot->max = (copy.max > copy.lastMax) ? copy.max : copy.lastMax;
+        if (snapshot->count > 2 * STATS_BLOCK) {
+            snapshot->count = 2 * STATS_BLOCK;
+        }
+        snapshot->mean = (copy.mean + 128) >> 8;
+        snapshot->variance = copy.variance >> 8;
+    }
+
+    snapshot->peakToPeak = snapshot->max - snapshot->min;
+    snapshot->deviation = stats_sqrt(snapshot->variance);
+}
@@ -0,0 +1,80 @@
+/*! \file
+ *  \brief Streaming statistics of a sample stream.
+ *
+ *  Every sample updates the statistics in constant time, independent of how
+ *  many samples have been seen or stored. Two kinds of windows are
+ *  available:
+ *    - STATS_CUMULATIVE: all samples since the last stats_reset. The exact
+ *      integer sums of the samples and their squares are kept (64 bit, no
+ *      rounding, no division per sample). The snapshot derives mean and
+ *      variance from them without cancellation (see stats_snapshot); it
+ *      uses 64 bit divisions and is meant for display rates, not for ISRs.
+ *    - STATS_SLIDING: the recent samples. Mean and variance are
+ *      exponentially weighted with the Welford-style update of West
+ *      (weight 2^-STATS_SLIDING_SHIFT, shifts only). Both are kept in Q16,
+ *      so the small weight does not leave a bias of up to a sample step
+ *      after the input has settled; minimum and maximum
+ *      cover the current and the previous block of STATS_BLOCK samples.
+ *
+ *  stats_add may be called from an ISR. stats_snapshot copies the
+ *  accumulators with interrupts disabled (a few dozen cycles) and computes
+ *  the results afterwards, so a snapshot is always consistent.
+ *
+ *  Samples are unsigned 16 bit values up to 4095 (e.g. ADC results).
+ */
+
+#ifndef _STATS_H
+#define _STATS_H
+
+#include <stdint.h>
+
+//! All samples since the last reset
+#define STATS_CUMULATIVE 0
+
+//! The recent samples
+#define STATS_SLIDING 1
+
+//! Weight of a new sample in the sliding window is 2^-STATS_SLIDING_SHIFT
+#define STATS_SLIDING_SHIFT 8
+
+//! Samples per min/max block of the sliding window (window: 1...2 blocks)
+#define STATS_BLOCK 256
+
+//! Accumulators of a window (only changed through the functions below)
+typedef struct {
+    uint8_t mode;        //!< STATS_CUMULATIVE or STATS_SLIDING
+    uint32_t count;      //!< Samples since the reset
+    uint16_t min;        //!< Minimum (sliding: of the current block)
+    uint16_t max;        //!< Maximum (sliding: of the current block)
+    uint16_t lastMin;    //!< Sliding: minimum of the previous block
+    uint16_t lastMax;    //!< Sliding: maximum of the previous block
+    uint64_t sum;        //!< Cumulative: sum of the samples
+    uint64_t sumSquares; //!< Cumulative: sum of the squared samples
+    int32_t mean;        //!< Sliding: mean (Q16)
+    uint64_t variance;   //!< Sliding: variance (Q16)
+} Stats;
+
+//! Results of a window
+typedef struct {
+    uint32_t count;      //!< Samples in the window (sliding: since the reset)
+    uint16_t min;        //!< Smallest sample
+    uint16_t max;        //!< Largest sample
+    uint16_t peakToPeak; //!< max - min
+    uint32_t mean;       //!< Mean (Q8, i.e. 1/256 of a sample step)
+    uint32_t variance;   //!< Variance (Q8)
+    uint16_t deviation;  //!< Standard deviation (Q4)
+} StatsSnapshot;
+
+//! Initializes a window of the passed mode
+void stats_init(Stats *stats, uint8_t mode);
+
+//! Restarts a window (e.g. to begin a new measurement)
+void stats_reset(Stats *stats);
+
+//! Adds a sample in constant time
+void stats_add(Stats *stats, uint16_t sample);
+
+//! Takes a consistent snapshot of the window
+void stats_snapshot(Stats const *stats, StatsSnapshot *snapshot);
+
+#endif
@@ -0,0 +1,111 @@
+#include "supply.h"
+#include "adc.h"
+#include "scheduler.h"
+
+/*! \file
+ *  Background task that measures the supply voltage with the bandgap.
+ */
+
+//! Timer of the task
+static uint8_t supplyTimer = SCHED_NO_TIMER;
+
+//! Interval of the task, 0 if stopped
+static uint16_t supplyInterval;
+
+//! No measurements are requested while set
+static bool supplyPaused;
+
+//! Measurements since supply_start
+static uint16_t supplyMeasurements;
+
+//! Smoothed supply voltage in millivolts
+static uint16_t supplyMv;
+
+/*!
+ *  Takes the result of the last measurement, if there is one, and requests
+ *  the next. A measurement that has not finished yet (e.g. because an
+ *  internal reference is selected) is taken at the next interval.
+ */
+static void supplyTask(void) {
+    uint16_t const code = getAdcBandgap();
+
+    if (code) {
+        uint16_t const mv = ((uint32_t)SUPPLY_BANDGAP_MV * 1024 + code / 2) / code;
+
+        // The first measurement is taken as it is, the others are smoothed
+        if (supplyMeasurements++) {
+            supplyMv += ((int16_t)(mv - supplyMv)) >> SUPPLY_SMOOTH_SHIFT;
+        } else {
+            supplyMv = mv;
+        }
+        setAdcSupply(supplyMv);
+    }
+
+    if (!supplyPaused) {
+        requestAdcBandgap();
+    }
+}
+
+/*!
+ *  Starts the measurements. The first result is taken after
+ *  SUPPLY_FIRST_MS, the next ones every interval.
+ *
+ *  \param intervalMs  Milliseconds between two measurements, 0 stops them.
+ */
+void supply_start(uint16_t intervalMs) {
+    supply_stop();
+    if (!intervalMs) {
+        return;
+    }
+
+    supplyInterval = intervalMs;
+    supplyMeasurements = 0;
+    getAdcBandgap();
+    if (!supplyPaused) {
+        requestAdcBandgap();
+    }
+    supplyTimer = sched_startTimer(supplyTask, SUPPLY_FIRST_MS, intervalMs);
+}
+
+/*!
+ *  Stops the measurements.
+ */
+void supply_stop(void) {
+    sched_stopTimer(supplyTimer);
+    supplyTimer = SCHED_NO_TIMER;
+    supplyInterval = 0;
+}
+
+/*!
+ *  Pauses or resumes the measurements. The task keeps running while paused
+ *  but requests none, so the last supply voltage stays in use; a request
+ *  that has not been served yet is withdrawn.
+ *
+ *  \param paused  true pauses, false resumes.
+ */
+void supply_pause(bool paused) {
+    supplyPaused = paused;
+    if (paused) {
+        cancelAdcBandgap();
+    } else if (supplyInterval) {
+        requestAdcBandgap();
+    }
+}
+
+/*!
+ *  Returns the interval of the measurements.
+ *
+ *  \return  Milliseconds, 0 if stopped.
+ */
+uint16_t supply_interval(void) {
+    return supplyInterval;
+}
+
+/*!
+ *  Returns the number of measurements.
+ *
+ *  \return  Measurements since supply_start.
+ */
+uint16_t supply_measurements(void) {
+    return supplyMeasurements;
+}
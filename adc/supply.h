@@ -0,0 +1,52 @@
+/*! \file
+ *  \brief Ratiometric compensation of the supply voltage.
+ *
+ *  Conversions against AVCC are relative to the supply, so a supply of
+ *  4.8V instead of 5V makes every voltage read 4% too high. A background
+ *  task of the scheduler lets the ADC convert the internal 1.1V bandgap
+ *  every interval and calculates AVCC = SUPPLY_BANDGAP_MV * 1024 / result.
+ *  The ADC scales all following conversions with it (setAdcSupply), with a
+ *  cached factor, so a sample costs no more than before. A measurement
+ *  takes the place of two samples, at 1kHz and an interval of one second
+ *  that are 0.2% of the samples. Programs that need every sample (capture,
+ *  recording, tone detection, the armed alarm) pause the measurements with
+ *  supply_pause.
+ *
+ *  The bandgap differs by up to 10% from chip to chip; SUPPLY_BANDGAP_MV
+ *  can be calibrated with a known supply.
+ */
+
+#ifndef _SUPPLY_H
+#define _SUPPLY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//! Voltage of the bandgap in millivolts
+#define SUPPLY_BANDGAP_MV 1100
+
+//! Default interval between two measurements
+#define SUPPLY_INTERVAL_MS 1000
+
+//! Time to wait for the first measurement
+#define SUPPLY_FIRST_MS 100
+
+//! Every measurement moves the supply by 2^-SUPPLY_SMOOTH_SHIFT of the difference
+#define SUPPLY_SMOOTH_SHIFT 2
+
+//! Starts (or restarts) the measurements every intervalMs, the scheduler has to be initialized
+void supply_start(uint16_t intervalMs);
+
+//! Stops the measurements, the last supply voltage stays in use
+void supply_stop(void);
+
+//! Pauses (or resumes) the measurements while every sample counts, e.g. during a capture
+void supply_pause(bool paused);
+
+//! Returns the interval of the measurements in milliseconds, 0 if stopped
+uint16_t supply_interval(void);
+
+//! Returns the number of measurements since supply_start
+uint16_t supply_measurements(void);
+
+#endif
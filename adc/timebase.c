@@ -0,0 +1,131 @@
+#include "timebase.h"
+#include "bin_clock.h"
+#include "latency.h"
+#include "led.h"
+#include "os_event.h"
+
+#include <stdbool.h>
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <util/atomic.h>
+
+/*! \file
+ *  Timer0 tick with fractional cycle accumulation.
+ */
+
+#if TIMEBASE_MS_CYCLES + TIMEBASE_TICK_CYCLES > 0xFFFF
+    #error "Cycle residue does not fit into 16 bits"
+#endif
+
+//! Milliseconds since timebase_init
+static volatile uint32_t tbMillis;
+
+//! CPU cycles since tbMillis was last advanced (0...TIMEBASE_MS_CYCLES - 1)
+static volatile uint16_t tbResidue;
+
+//! Milliseconds until the binary clock is advanced
+static uint8_t tbClockDivider;
+
+//! Whether Timer0 has been started
+static bool tbRunning;
+
+/*!
+ *  Starts Timer0 in CTC mode with a tick of TIMEBASE_TICK_COUNTS counts.
+ *  Calling it again does not disturb a running timebase.
+ */
+void timebase_init(void) {
+    if (tbRunning) {
+        return;
+    }
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        tbMillis = 0;
+        tbResidue = 0;
+        tbClockDivider = 10;
+
+        // CTC mode, TOP = OCR0A
+        TCCR0A = (1 << WGM01);
+        TCCR0B = TIMEBASE_CLOCK_SELECT;
+        OCR0A = TIMEBASE_TICK_COUNTS - 1;
+        TCNT0 = 0;
+
+        // Enable compare match interrupt
+        TIMSK0 |= (1 << OCIE0A);
+        tbRunning = true;
+    }
+    sei();
+}
+
+/*!
+ *  \return The milliseconds since timebase_init.
+ */
+uint32_t timebase_millis(void) {
+    uint32_t millis;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        millis = tbMillis;
+    }
+    return millis;
+}
+
+/*!
+ *  Combines the millisecond counter with the current count of Timer0.
+ *  The resolution is one timer count (12.8us at 20MHz).
+ *
+ *  \return The microseconds since timebase_init.
+ */
+uint32_t timebase_micros(void) {
+    uint32_t millis;
+    uint16_t residue;
+    uint8_t count;
+    bool pending;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        millis = tbMillis;
+        residue = tbResidue;
+        count = TCNT0;
+
+        // A tick that has not been handled yet: the counter already restarted
+        pending = TIFR0 & (1 << OCF0A);
+        if (pending) {
+            count = TCNT0;
+        }
+    }
+
+    uint32_t cycles = residue + (uint32_t)count * TIMEBASE_PRESCALER;
+    if (pending) {
+        cycles += TIMEBASE_TICK_CYCLES;
+    }
+
+    return millis * 1000 + ((cycles * TIMEBASE_US_RECIPROCAL) >> 16);
+}
+
+/*!
+ *  Tick of the timebase. Advances the millisecond counter by the exact number
+ *  of CPU cycles per tick, samples the buttons every millisecond and advances
+ *  the binary clock every 10ms. The software PWM of the LEDs advances every
+ *  tick.
+ */
+ISR(TIMER0_COMPA_vect) {
+    uint16_t const start = latency_now();
+    uint16_t residue = tbResidue + TIMEBASE_TICK_CYCLES;
+    uint8_t elapsed = 0;
+
+    while (residue >= TIMEBASE_MS_CYCLES) {
+        residue -= TIMEBASE_MS_CYCLES;
+        elapsed++;
+    }
+    tbResidue = residue;
+    tbMillis += elapsed;
+
+    tickLedBar();
+
+    while (elapsed--) {
+        os_eventTick();
+        if (!--tbClockDivider) {
+            tbClockDivider = 10;
+            updateClock();
+        }
+    }
+
+    latency_isrDone(start);
+}
@@ -0,0 +1,62 @@
+/*! \file
+ *  \brief Monotonic timebase.
+ *  Runs Timer0 with a tick of about 1ms and provides a millisecond counter
+ *  and microsecond timestamps for the whole program.
+ *
+ *  A tick is a whole number of timer counts, so its length usually differs
+ *  slightly from 1ms (998.4us at 20MHz). The ISR therefore accumulates the
+ *  exact number of CPU cycles per tick and only advances the millisecond
+ *  counter when a full millisecond of cycles has passed. The counter does
+ *  not drift, its jitter is below one tick.
+ *
+ *  The timer configuration is derived from F_CPU at compile time.
+ */
+
+#ifndef _TIMEBASE_H
+#define _TIMEBASE_H
+
+#include <stdint.h>
+
+#include "atmega644Constants.h"
+
+//! CPU cycles per millisecond
+#define TIMEBASE_MS_CYCLES (F_CPU / 1000UL)
+
+// Smallest prescaler of Timer0 that allows a tick of about 1ms
+#if TIMEBASE_MS_CYCLES / 8 <= 256
+    #define TIMEBASE_PRESCALER 8
+    #define TIMEBASE_CLOCK_SELECT (1 << CS01)
+#elif TIMEBASE_MS_CYCLES / 64 <= 256
+    #define TIMEBASE_PRESCALER 64
+    #define TIMEBASE_CLOCK_SELECT ((1 << CS01) | (1 << CS00))
+#elif TIMEBASE_MS_CYCLES / 256 <= 256
+    #define TIMEBASE_PRESCALER 256
+    #define TIMEBASE_CLOCK_SELECT (1 << CS02)
+#else
+    #define TIMEBASE_PRESCALER 1024
+    #define TIMEBASE_CLOCK_SELECT ((1 << CS02) | (1 << CS00))
+#endif
+
+//! Timer counts per tick (rounded)
+#define TIMEBASE_TICK_COUNTS ((TIMEBASE_MS_CYCLES + TIMEBASE_PRESCALER / 2) / TIMEBASE_PRESCALER)
+
+//! Exact CPU cycles per tick
+#define TIMEBASE_TICK_CYCLES (TIMEBASE_TICK_COUNTS * TIMEBASE_PRESCALER)
+
+//! Converts CPU cycles to microseconds by (cycles * reciprocal) >> 16
+#define TIMEBASE_US_RECIPROCAL ((uint32_t)((65536ULL * 1000000ULL + F_CPU / 2) / F_CPU))
+
+#if TIMEBASE_TICK_COUNTS > 256
+    #error "F_CPU too high for a 1ms tick on Timer0"
+#endif
+
+//! Starts Timer0 (does nothing if the timebase is already running)
+void timebase_init(void);
+
+//! Returns the milliseconds since timebase_init
+uint32_t timebase_millis(void);
+
+//! Returns the microseconds since timebase_init (wraps after 71 minutes)
+uint32_t timebase_micros(void);
+
+#endif
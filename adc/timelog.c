@@ -0,0 +1,229 @@
+#include "timelog.h"
+
+#include <util/atomic.h>
+
+/*! \file
+ *  Timestamps encoded as changes of the interval, with an index of marks.
+ */
+
+//! Entries between two marks minus one
+#define TIMELOG_MARK_MASK ((1 << TIMELOG_MARK_SHIFT) - 1)
+
+//! Number of marks
+#define TIMELOG_MARKS (TIMELOG_ENTRIES >> TIMELOG_MARK_SHIFT)
+
+//! An entry of the index, the place to start decoding
+typedef struct {
+    uint32_t time;     //!< Timestamp of the entry
+    uint32_t interval; //!< Interval from the entry before (0 for the first)
+    uint16_t offset;   //!< First byte of the next entry
+} TimelogMark;
+
+//! Encoded entries and the bytes of them in use
+static uint8_t timelogData[TIMELOG_BYTES];
+static uint16_t timelogUsed;
+
+//! Index
+static TimelogMark timelogMarks[TIMELOG_MARKS];
+
+//! Timestamp and interval of the last entry
+static uint32_t timelogLast, timelogInterval;
+
+//! Number of entries, written last when an entry is appended
+static volatile uint8_t timelogCount;
+
+/*!
+ *  Removes all entries.
+ */
+void timelog_clear(void) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        timelogCount = 0;
+        timelogUsed = 0;
+        timelogInterval = 0;
+    }
+}
+
+/*!
+ *  Appends a timestamp. Entries are expected in the order of time, the
+ *  timestamps may wrap.
+ *
+ *  \param time  Microseconds, e.g. timebase_micros().
+ *  \return      False if the log is full, the entry is not stored then.
+ */
+bool timelog_append(uint32_t time) {
+    uint8_t const count = timelogCount;
+    uint32_t const interval = count ? time - timelogLast : 0;
+
+    if (count >= TIMELOG_ENTRIES) {
+        return false;
+    }
+
+    if (!(count & TIMELOG_MARK_MASK)) {
+        TimelogMark *const mark = &timelogMarks[count >> TIMELOG_MARK_SHIFT];
+
+        mark->time = time;
+        mark->interval = interval;
+        mark->offset = timelogUsed;
+    } else {
+        int32_t const change = interval - timelogInterval;
+        uint32_t zigzag = ((uint32_t)change << 1) ^ (uint32_t)(change >> 31);
+        uint16_t used = timelogUsed;
+
+        // The bytes only count when the whole entry fits
+        do {
+            uint8_t byte = zigzag & 0x7F;
+
+            if (used >= TIMELOG_BYTES) {
+                return false;
+            }
+            zigzag >>= 7;
+            if (zigzag) {
+                byte |= 0x80;
+            }
+            timelogData[used++] = byte;
+        } while (zigzag);
+        timelogUsed = used;
+    }
+
+    timelogLast = time;
+    timelogInterval = interval;
+    timelogCount = count + 1;
+    return true;
+}
+
+/*!
+ *  Returns the number of entries.
+ *
+ *  \return  0...TIMELOG_ENTRIES.
+ */
+uint8_t timelog_count(void) {
+    return timelogCount;
+}
+
+/*!
+ *  Returns the number of bytes used by the encoded entries.
+ *
+ *  \return  0...TIMELOG_BYTES (the marks are not included).
+ */
+uint16_t timelog_bytes(void) {
+    uint16_t used;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        used = timelogUsed;
+    }
+    return used;
+}
+
+/*!
+ *  Copies a mark, an ISR may write the next one.
+ *
+ *  \param mark   Index of the mark.
+ *  \param copy   Receives the mark.
+ */
+static void readMark(uint8_t mark, TimelogMark *copy) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        *copy = timelogMarks[mark];
+    }
+}
+
+/*!
+ *  Decodes the next entry after the one in state.
+ *
+ *  \param state  The entry before, becomes the decoded entry.
+ */
+static void decodeEntry(TimelogMark *state) {
+    uint32_t zigzag = 0;
+    uint8_t shift = 0;
+    uint8_t byte;
+
+    do {
+        byte = timelogData[state->offset++];
+        zigzag |= (uint32_t)(byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+
+    state->interval += (zigzag >> 1) ^ -(zigzag & 1);
+    state->time += state->interval;
+}
+
+/*!
+ *  Returns the timestamp of an entry.
+ *
+ *  \param entry  Index of the entry.
+ *  \return       Microseconds as passed to timelog_append, 0 for an invalid
+ *                entry.
+ */
+uint32_t timelog_time(uint8_t entry) {
+    TimelogMark state;
+    uint8_t n;
+
+    if (entry >= timelogCount) {
+        return 0;
+    }
+
+    readMark(entry >> TIMELOG_MARK_SHIFT, &state);
+    for (n = entry & TIMELOG_MARK_MASK; n; n--) {
+        decodeEntry(&state);
+    }
+    return state.time;
+}
+
+/*!
+ *  Returns the time of an entry relative to the first one.
+ *
+ *  \param entry  Index of the entry.
+ *  \return       Microseconds after the first entry, 0 for an invalid entry.
+ */
+uint32_t timelog_elapsed(uint8_t entry) {
+    TimelogMark first;
+
+    if (entry >= timelogCount) {
+        return 0;
+    }
+
+    readMark(0, &first);
+    return timelog_time(entry) - first.time;
+}
+
+/*!
+ *  Finds an entry by its time: a binary search over the marks, then at most
+ *  2^TIMELOG_MARK_SHIFT - 1 entries are decoded.
+ *
+ *  \param elapsed  Microseconds after the first entry.
+ *  \return         The first entry at or after that time, timelog_count()
+ *                  if there is none.
+ */
+uint8_t timelog_find(uint32_t elapsed) {
+    uint8_t const count = timelogCount;
+    uint8_t low = 0;
+    uint8_t high = (count + TIMELOG_MARK_MASK) >> TIMELOG_MARK_SHIFT;
+    uint8_t entry;
+    TimelogMark first, state;
+
+    if (!count) {
+        return 0;
+    }
+    readMark(0, &first);
+
+    // Last mark at or before the time (the first one always is)
+    while (high - low > 1) {
+        uint8_t const middle = (low + high) >> 1;
+
+        readMark(middle, &state);
+        if (state.time - first.time <= elapsed) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+
+    readMark(low, &state);
+    entry = low << TIMELOG_MARK_SHIFT;
+    while (state.time - first.time < elapsed) {
+        if (++entry >= count || !(entry & TIMELOG_MARK_MASK)) {
+            // The next mark is after the time, or there is no later entry
+            return entry;
+        }
+        decodeEntry(&state);
+    }
+    return entry;
+}
@@ -0,0 +1,58 @@
+/*! \file
+ *  \brief Compact log of timestamps.
+ *
+ *  Keeps the time of every stored sample (from timebase_micros). An entry
+ *  is stored as the change of its interval to the interval before
+ *  (zigzag and varint encoded: 7 bits per byte, the highest bit marks
+ *  that another byte follows). Samples at a fixed rate with a jitter
+ *  below 64us cost one byte each. A change of the rate costs two or three
+ *  bytes, and an entry seconds after the last one costs four.
+ *
+ *  Every 2^TIMELOG_MARK_SHIFT-th entry is not encoded but kept in an
+ *  index of marks with its absolute time and interval and the position
+ *  of the bytes that follow. Reading an entry decodes at most
+ *  2^TIMELOG_MARK_SHIFT - 1 entries from its mark on. An entry is found by
+ *  its time with a binary search over the marks.
+ *
+ *  timelog_append may run in an ISR (estimated at about 60 cycles for a
+ *  one byte entry and 80 at a mark, not measured). While an ISR appends,
+ *  the entries that are already there can be read.
+ */
+
+#ifndef _TIMELOG_H
+#define _TIMELOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//! Bytes for the encoded entries
+#define TIMELOG_BYTES 384
+
+//! Maximum number of entries (a multiple of 2^TIMELOG_MARK_SHIFT)
+#define TIMELOG_ENTRIES 128
+
+//! Every 2^TIMELOG_MARK_SHIFT-th entry is a mark of the index
+#define TIMELOG_MARK_SHIFT 4
+
+//! Removes all entries
+void timelog_clear(void);
+
+//! Appends a timestamp in microseconds, returns false if the log is full
+bool timelog_append(uint32_t time);
+
+//! Returns the number of entries
+uint8_t timelog_count(void);
+
+//! Returns the number of bytes used by the encoded entries
+uint16_t timelog_bytes(void);
+
+//! Returns the timestamp of an entry, 0 for an invalid entry
+uint32_t timelog_time(uint8_t entry);
+
+//! Returns the microseconds from the first entry to an entry, 0 for an invalid entry
+uint32_t timelog_elapsed(uint8_t entry);
+
+//! Returns the first entry at least elapsed microseconds after the first one, timelog_count() if there is none
+uint8_t timelog_find(uint32_t elapsed);
+
+#endif